@@ -0,0 +1,3 @@
+find_package(Threads REQUIRED)
+
+link_libraries(Threads::Threads)
\ No newline at end of file
@@ -77,8 +77,8 @@ Metal_Intersection intersectTrianglesInBox(Metal_LocalRay ray, int meshObjectInd
         int currentBoundingBoxIndex = boundingBoxIndexStack[--stackSize];
         Metal_NestedBoundingBox box = boundingBoxes[currentBoundingBoxIndex];
         
-        //if(!intersectsBoundingBox(ray, box))
-        //    continue;
+        if(!intersectsBoundingBox(ray, box))
+            continue;
         
         if(box.indicesOffset == -1){
             if(box.childLeftIndex != -1 )
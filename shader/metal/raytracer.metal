@@ -67,6 +67,8 @@ kernel void raytrace(
             
             if(intersection.hit && intersection.distance < currentHit.distance){
                 currentHit = intersection;
+                /// the hit point of the local ray is in object space
+                currentHit.hitPoint = currentRay.origin + (currentRay.direction * intersection.distance);
                 currentRotatedNormal = rotateNormal(meshObject.rotation, intersection.normal);
                 currentColor = meshObject.color;
                 currentSpecularIntensity = meshObject.specularIntensity;
@@ -82,7 +82,7 @@ struct Metal_Light {
 
 #define METAL_COLOR_COUNT_MAX ((unsigned)10)
 /// max stack size for nested bounding box traversing
-#define METAL_NESTING_BB_STACK ((unsigned) 40)
+#define METAL_NESTING_BB_STACK ((unsigned) 64)
 
 /// naive bounding box checking, not using nested structure
 //#define NAIVE_BOUNDING_BOX
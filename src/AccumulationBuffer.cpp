@@ -0,0 +1,70 @@
+#include "AccumulationBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace RayTracing {
+    AccumulationBuffer::AccumulationBuffer(const Vec2u &size)
+        : width(size.getX()), height(size.getY()), sums((size_t) size.getX() * size.getY(), RGBf(0, 0, 0, 0)),
+          counts((size_t) size.getX() * size.getY(), 0), luminanceSquares((size_t) size.getX() * size.getY(), 0),
+          converged((size_t) size.getX() * size.getY(), false) {
+    }
+
+    void AccumulationBuffer::clear() {
+        std::ranges::fill(sums, RGBf(0, 0, 0, 0));
+        std::ranges::fill(counts, 0);
+        std::ranges::fill(luminanceSquares, 0);
+        converged.assign(converged.size(), false);
+    }
+
+    RGBf AccumulationBuffer::average(unsigned x, unsigned y) const {
+        unsigned count = counts[y * width + x];
+        return count == 0 ? RGBf::BLACK() : RGBf(sums[y * width + x] / (float) count);
+    }
+
+    float AccumulationBuffer::standardError(unsigned x, unsigned y) const {
+        const unsigned count = counts[y * width + x];
+        if (count < 2) {
+            return std::numeric_limits<float>::infinity();
+        }
+        const float mean = luminance(sums[y * width + x]) / (float) count;
+        // unbiased sample variance, clamped as the float sums can cancel to slightly negative values
+        const float variance = std::max(0.f, (luminanceSquares[y * width + x] - (float) count * mean * mean) /
+                                             (float) (count - 1));
+        return std::sqrt(variance / (float) count);
+    }
+
+    unsigned AccumulationBuffer::updateConvergence(float maxError, unsigned minSamples, unsigned maxSamples) {
+        unsigned active = 0;
+        for (unsigned y = 0; y < height; y++) {
+            for (unsigned x = 0; x < width; x++) {
+                const unsigned count = counts[y * width + x];
+                if (count >= maxSamples || (count >= minSamples && standardError(x, y) <= maxError)) {
+                    converged[y * width + x] = true;
+                } else if (!converged[y * width + x]) {
+                    active++;
+                }
+            }
+        }
+        return active;
+    }
+
+    void AccumulationBuffer::resolve(Image *image) const {
+        for (unsigned y = 0; y < height; y++) {
+            for (unsigned x = 0; x < width; x++) {
+                image->setPixel(x, y, average(x, y));
+            }
+        }
+    }
+
+    void AccumulationBuffer::resolveSampleCounts(Image *image) const {
+        const unsigned maxCount = std::max(1u, std::ranges::max(counts));
+        for (unsigned y = 0; y < height; y++) {
+            for (unsigned x = 0; x < width; x++) {
+                const float brightness = (float) counts[y * width + x] / (float) maxCount;
+                image->setPixel(x, y, RGBf(brightness, brightness, brightness, 1));
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+
+#include "Color.hpp"
+#include "Image.hpp"
+
+namespace RayTracing {
+    /**
+     * Floating point sums of the samples traced for every pixel, resolved into an image by averaging them.
+     * The squared luminance of the samples is summed as well, so the standard error of every pixel can be estimated
+     * and converged pixels can be excluded from further passes for adaptive sampling.
+     */
+    class AccumulationBuffer {
+    private:
+        unsigned width, height;
+        /// sum of the sample colors of every pixel, row by row
+        std::vector<RGBf> sums;
+        /// number of samples added to every pixel, row by row
+        std::vector<unsigned> counts;
+        /// sum of the squared luminance of the samples of every pixel, row by row
+        std::vector<float> luminanceSquares;
+        /// pixels that do not need more samples, only changed between passes by updateConvergence
+        std::vector<bool> converged;
+
+        /// Get the perceived brightness of a color
+        static float luminance(const RGBf &color) {
+            return 0.2126f * color.getR() + 0.7152f * color.getG() + 0.0722f * color.getB();
+        }
+
+    public:
+        AccumulationBuffer() = delete;
+
+        explicit AccumulationBuffer(const Vec2u &size);
+
+        /// Remove all samples
+        void clear();
+
+        /**
+         * Add the color of a sample to a pixel, different pixels may be added from different threads
+         * @param x x coordinate
+         * @param y y coordinate
+         * @param color color of the traced sample, not clamped
+         */
+        void add(unsigned x, unsigned y, const RGBf &color) {
+            const float brightness = luminance(color);
+            sums[y * width + x] += color;
+            counts[y * width + x]++;
+            luminanceSquares[y * width + x] += brightness * brightness;
+        }
+
+        /// Get the number of samples added to the pixel at (x, y)
+        [[nodiscard]] unsigned sampleCount(unsigned x, unsigned y) const { return counts[y * width + x]; }
+
+        /// Get the average color of the samples of the pixel at (x, y), black if it has none
+        [[nodiscard]] RGBf average(unsigned x, unsigned y) const;
+
+        /**
+         * Estimate the standard error of the average luminance of a pixel from the variance of its samples
+         * @param x x coordinate
+         * @param y y coordinate
+         * @return standard error, infinite for less than two samples
+         */
+        [[nodiscard]] float standardError(unsigned x, unsigned y) const;
+
+        /// Check if the pixel at (x, y) was marked as converged and is skipped by further passes
+        [[nodiscard]] bool isConverged(unsigned x, unsigned y) const { return converged[y * width + x]; }
+
+        /**
+         * Mark the pixels that do not need more samples as converged, must not be called while samples are added
+         * @param maxError pixels with a standard error of at most maxError converge
+         * @param minSamples number of samples a pixel needs before its error estimate is trusted
+         * @param maxSamples pixels with this many samples converge regardless of their error
+         * @return number of pixels that are not converged yet
+         */
+        unsigned updateConvergence(float maxError, unsigned minSamples, unsigned maxSamples);
+
+        /**
+         * Write the average color of every pixel into an image
+         * @param image image of the size of the buffer
+         */
+        void resolve(Image *image) const;
+
+        /**
+         * Write the number of samples of every pixel into an image as brightness, the pixels with the most samples
+         * are white
+         * @param image image of the size of the buffer
+         */
+        void resolveSampleCounts(Image *image) const;
+    };
+}
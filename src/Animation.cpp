@@ -0,0 +1,60 @@
+#include "Animation.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace RayTracing {
+    /// Read an optional [x, y, z] array of a keyframe, keeping the fallback if it is missing
+    static Vec3 readVec3(const nlohmann::json &data, const char *key, const Vec3 &fallback) {
+        if (!data.contains(key)) {
+            return fallback;
+        }
+        auto values = data[key].get<std::array<float, 3> >();
+        return {values[0], values[1], values[2]};
+    }
+
+    Animation Animation::fromJson(const nlohmann::json &data, const Transform &initial) {
+        Animation animation;
+        animation.morphTarget = data.value("morphTarget", "");
+        Keyframe previous{0, initial.getTranslation(), initial.getRotation(), initial.getScale(), 0};
+        for (const auto &keyframeData: data.at("keyframes")) {
+            Keyframe keyframe = previous;
+            keyframe.frame = keyframeData.at("frame").get<unsigned>();
+            keyframe.position = readVec3(keyframeData, "position", previous.position);
+            keyframe.rotation = keyframeData.contains("rotation")
+                                    ? readVec3(keyframeData, "rotation", {}).asDegreeToRadian()
+                                    : previous.rotation;
+            keyframe.scale = readVec3(keyframeData, "scale", previous.scale);
+            keyframe.morph = keyframeData.value("morph", previous.morph);
+            animation.keyframes.push_back(keyframe);
+            previous = keyframe;
+        }
+        std::stable_sort(animation.keyframes.begin(), animation.keyframes.end(),
+                         [](const Keyframe &a, const Keyframe &b) { return a.frame < b.frame; });
+        return animation;
+    }
+
+    Keyframe Animation::sample(unsigned frame) const {
+        if (keyframes.empty()) {
+            return {};
+        }
+        if (frame <= keyframes.front().frame) {
+            return keyframes.front();
+        }
+        if (frame >= keyframes.back().frame) {
+            return keyframes.back();
+        }
+        auto next = std::upper_bound(keyframes.begin(), keyframes.end(), frame,
+                                     [](unsigned f, const Keyframe &keyframe) { return f < keyframe.frame; });
+        const Keyframe &a = *(next - 1);
+        const Keyframe &b = *next;
+        float t = (float) (frame - a.frame) / (float) (b.frame - a.frame);
+        return {
+            frame,
+            a.position + (b.position - a.position) * t,
+            a.rotation + (b.rotation - a.rotation) * t,
+            a.scale + (b.scale - a.scale) * t,
+            a.morph + (b.morph - a.morph) * t
+        };
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "Transform.hpp"
+
+namespace RayTracing {
+    /// State of an animated object at a single frame
+    struct Keyframe {
+        unsigned frame = 0;
+        Vec3 position{};
+        /// rotation in radians
+        Vec3 rotation{};
+        Vec3 scale{1, 1, 1};
+        /// blend weight of the morph target, 0 is the loaded mesh and 1 the morph target
+        float morph = 0;
+    };
+
+    /// Keyframed transform and morph weight of an object, linearly interpolated between keyframes
+    class Animation {
+    private:
+        /// keyframes sorted by frame
+        std::vector<Keyframe> keyframes;
+
+    public:
+        /// file name of the morph target mesh, relative to the scene, empty if the mesh is not deformed
+        std::string morphTarget{};
+
+        Animation() = default;
+
+        /**
+         * Load an animation from the json of an object.
+         * Every keyframe needs a frame number, position, rotation (degrees), scale and morph are optional and default
+         * to the values of the previous keyframe (the initial transform of the object for the first one).
+         * @param data json object containing the keyframes array and an optional morphTarget
+         * @param initial transform of the object as declared in the scene
+         * @return loaded animation
+         */
+        static Animation fromJson(const nlohmann::json &data, const Transform &initial);
+
+        /// Returns true if the object has keyframes
+        [[nodiscard]] bool isAnimated() const { return !keyframes.empty(); }
+
+        /// Get the number of frames of the animation, the last keyframe frame plus one
+        [[nodiscard]] unsigned frameCount() const { return keyframes.empty() ? 1 : keyframes.back().frame + 1; }
+
+        /**
+         * Interpolate the state of the object at a frame, frames outside the keyframes are clamped
+         * @param frame frame to sample
+         * @return interpolated keyframe
+         */
+        [[nodiscard]] Keyframe sample(unsigned frame) const;
+    };
+}
@@ -57,7 +57,7 @@ namespace RayTracing {
         };
     }
 
-    bool LocalRay::intersectsBoundingBox(const BoundingBox &box) const {
+    bool Ray::intersectsBoundingBox(const BoundingBox &box, float maxDistance) const {
         float tmin = -INFINITY;
         float tmax = INFINITY;
 
@@ -77,7 +77,7 @@ namespace RayTracing {
                 }
             }
         }
-        return tmax >= tmin && tmin >= 0;
+        return tmax >= tmin && tmin >= 0 && tmin < maxDistance;
     }
 
     // native cpp implementation
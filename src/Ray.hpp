@@ -20,10 +20,14 @@ namespace RayTracing {
         Vec3 origin;
         Vec3 direction;
         Vec3 rngSeed; /// Seed for random number generation, since shaders don't have good random functions
-        std::vector<RGBf> colors;
+        /// product of the colors of all surfaces the ray bounced off so far
+        RGBf throughput{1, 1, 1, 1};
+        /// number of surfaces the ray bounced off, light sources are not counted
+        unsigned surfaceHits = 0;
 
         unsigned idX, idY;
 
+        /// color of the light source that ended the path, transparent black if none was hit
         RGBf lightColor{0, 0, 0, 0};
         float totalDistance = 0;
 
@@ -50,6 +54,14 @@ namespace RayTracing {
          * @return intersection point on sphere
          */
         [[nodiscard]] HitInfo intersectSphere(const Vec3 &sphereCenter, float sphereRadius) const;
+
+        /**
+         * Check if this ray intersects with a bounding box
+         * @param box the bounding box to check against
+         * @param maxDistance boxes entered at or beyond this distance are not intersected
+         * @return true if the ray intersects the bounding box, false otherwise
+         */
+        [[nodiscard]] bool intersectsBoundingBox(const BoundingBox &box, float maxDistance = INFINITY) const;
     };
 
     /// Represents a ray in local object space
@@ -61,12 +73,5 @@ namespace RayTracing {
          * @return intersection point on triangle
          */
         [[nodiscard]] HitInfo intersectTriangle(Vec3 triangle[], const Vec3 &customNormal) const;
-
-        /**
-         * Check if this ray intersects with a bounding box
-         * @param box the bounding box to check against
-         * @return true if the ray intersects the bounding box, false otherwise
-         */
-        [[nodiscard]] bool intersectsBoundingBox(const BoundingBox &box) const;
     };
 }
\ No newline at end of file
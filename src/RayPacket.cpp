@@ -0,0 +1,114 @@
+#include "RayPacket.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace RayTracing {
+    void RayPacket::setRay(unsigned index, const Ray &ray, float distance) {
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            origin[axis][index] = ray.origin[axis];
+            direction[axis][index] = ray.direction[axis];
+            inverseDirection[axis][index] = 1.0f / ray.direction[axis];
+        }
+        maxDistance[index] = distance;
+        primitive[index] = NO_PRIMITIVE;
+    }
+
+    LocalRay RayPacket::getRay(unsigned index) const {
+        LocalRay ray;
+        ray.origin = {origin[0][index], origin[1][index], origin[2][index]};
+        ray.direction = {direction[0][index], direction[1][index], direction[2][index]};
+        return ray;
+    }
+
+    void RayPacket::updateBounds(uint64_t mask) {
+        // rays that are not selected are tested in the lanes of the selected ones, they never hit anything but
+        // should not be uninitialized either
+        for (unsigned i = 0; i < size || i % RAY_PACKET_LANES != 0; i++) {
+            if (i < size && ((mask >> i) & 1) != 0) {
+                continue;
+            }
+            for (unsigned axis = 0; axis < 3; axis++) {
+                origin[axis][i] = direction[axis][i] = inverseDirection[axis][i] = 0;
+            }
+            maxDistance[i] = -INFINITY;
+            primitive[i] = NO_PRIMITIVE;
+        }
+
+        intervalCulling = mask != 0;
+        for (unsigned axis = 0; axis < 3; axis++) {
+            originLow[axis] = inverseLow[axis] = INFINITY;
+            originHigh[axis] = inverseHigh[axis] = -INFINITY;
+            for (uint64_t rays = mask; rays != 0; rays &= rays - 1) {
+                unsigned i = std::countr_zero(rays);
+                originLow[axis] = std::min(originLow[axis], origin[axis][i]);
+                originHigh[axis] = std::max(originHigh[axis], origin[axis][i]);
+                inverseLow[axis] = std::min(inverseLow[axis], inverseDirection[axis][i]);
+                inverseHigh[axis] = std::max(inverseHigh[axis], inverseDirection[axis][i]);
+            }
+            intervalCulling &= std::isfinite(originLow[axis]) && std::isfinite(originHigh[axis]) &&
+                    std::isfinite(inverseLow[axis]) && std::isfinite(inverseHigh[axis]);
+        }
+    }
+
+    uint64_t RayPacket::intersectBox(const BoundingBox &box, uint64_t mask) const {
+        if (intervalCulling) {
+            // interval arithmetic over all rays: the entry distance of every ray is at least lowestEntry and its exit
+            // distance at most highestExit, so the box is missed by all rays if the entry is beyond the exit
+            float lowestEntry = 0;
+            float highestExit = INFINITY;
+            for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                float planeLow[2] = {box.minPos[axis] - originHigh[axis], box.maxPos[axis] - originHigh[axis]};
+                float planeHigh[2] = {box.minPos[axis] - originLow[axis], box.maxPos[axis] - originLow[axis]};
+                float entry = INFINITY;
+                float exit = -INFINITY;
+                for (unsigned plane = 0; plane < 2; plane++) {
+                    float products[4] = {
+                        planeLow[plane] * inverseLow[axis], planeLow[plane] * inverseHigh[axis],
+                        planeHigh[plane] * inverseLow[axis], planeHigh[plane] * inverseHigh[axis]
+                    };
+                    entry = std::min({entry, products[0], products[1], products[2], products[3]});
+                    exit = std::max({exit, products[0], products[1], products[2], products[3]});
+                }
+                lowestEntry = std::max(lowestEntry, entry);
+                highestExit = std::min(highestExit, exit);
+            }
+            if (lowestEntry > highestExit) {
+                return 0;
+            }
+        }
+
+        using Lanes = FloatLanes<RAY_PACKET_LANES>::Type;
+        constexpr uint64_t laneMask = (1ull << RAY_PACKET_LANES) - 1;
+        const Lanes zero = Lanes::broadcast(0);
+        Lanes minPlane[3];
+        Lanes maxPlane[3];
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            minPlane[axis] = Lanes::broadcast(box.minPos[axis]);
+            maxPlane[axis] = Lanes::broadcast(box.maxPos[axis]);
+        }
+
+        uint64_t hits = 0;
+        for (unsigned first = 0; first < size; first += RAY_PACKET_LANES) {
+            if (((mask >> first) & laneMask) == 0) {
+                continue;
+            }
+            Lanes entry[3];
+            Lanes exit[3];
+            for (unsigned axis = 0; axis < 3; axis++) {
+                Lanes rayOrigin = Lanes::load(&origin[axis][first]);
+                Lanes inverse = Lanes::load(&inverseDirection[axis][first]);
+                Lanes toMin = (minPlane[axis] - rayOrigin) * inverse;
+                Lanes toMax = (maxPlane[axis] - rayOrigin) * inverse;
+                entry[axis] = Lanes::min(toMin, toMax);
+                exit[axis] = Lanes::max(toMin, toMax);
+            }
+            Lanes tNear = Lanes::max(Lanes::max(entry[0], entry[1]), Lanes::max(entry[2], zero));
+            Lanes tFar = Lanes::min(Lanes::min(exit[0], exit[1]),
+                                    Lanes::min(exit[2], Lanes::load(&maxDistance[first])));
+            hits |= (uint64_t) Lanes::lessEqualMask(tNear, tFar) << first;
+        }
+        return hits & mask;
+    }
+}
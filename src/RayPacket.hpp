@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+
+#include "Ray.hpp"
+#include "math/simd.hpp"
+
+namespace RayTracing {
+#if defined(RAYTRACER_SIMD_AVX) || defined(RAYTRACER_SIMD_NEON)
+    /// number of rays of a packet tested at once, one AVX register or a pair of NEON registers
+    constexpr unsigned RAY_PACKET_LANES = 8;
+#else
+    /// number of rays of a packet tested at once, one SSE register
+    constexpr unsigned RAY_PACKET_LANES = 4;
+#endif
+
+    /**
+     * Coherent rays traced through a hierarchy together, stored as structure of arrays so neighbouring rays are
+     * tested in the lanes of one SIMD register. Rays are selected by bit masks, bit i selects ray i.
+     * The bounds of the origins and inverse directions allow rejecting a box for all rays with a single interval test.
+     */
+    struct alignas(32) RayPacket {
+        /// maximum number of rays, one bit of a 64 bit mask per ray
+        static constexpr unsigned MAX_SIZE = 64;
+        /// primitive index of rays that did not hit a triangle
+        static constexpr uint32_t NO_PRIMITIVE = UINT32_MAX;
+
+        float origin[3][MAX_SIZE];
+        float direction[3][MAX_SIZE];
+        float inverseDirection[3][MAX_SIZE];
+        /// distance of the closest hit of every ray so far, boxes and triangles beyond it are not intersected
+        float maxDistance[MAX_SIZE];
+        /// index of the closest triangle hit by every ray, set by the triangle tests of a mesh
+        uint32_t primitive[MAX_SIZE];
+        /// number of rays in the packet
+        unsigned size = 0;
+
+    private:
+        /// bounds of the origins and inverse directions of the selected rays per axis
+        float originLow[3], originHigh[3], inverseLow[3], inverseHigh[3];
+        /// false if an inverse direction is infinite, the interval test is skipped then
+        bool intervalCulling = false;
+
+    public:
+        /**
+         * Set a ray of the packet, the primitive of the ray is reset
+         * @param index index of the ray, less than MAX_SIZE
+         * @param ray ray to copy origin and direction from
+         * @param distance distance of the closest hit so far
+         */
+        void setRay(unsigned index, const Ray &ray, float distance);
+
+        /// Get the ray at index with the origin and direction it was set with
+        [[nodiscard]] LocalRay getRay(unsigned index) const;
+
+        /// Get the mask selecting all rays of the packet
+        [[nodiscard]] uint64_t fullMask() const { return size == MAX_SIZE ? ~0ull : (1ull << size) - 1; }
+
+        /**
+         * Calculate the bounds of the selected rays for the interval test and clear all other lanes up to the end of
+         * the last SIMD register. Has to be called after the selected rays are set.
+         * @param mask selected rays
+         */
+        void updateBounds(uint64_t mask);
+
+        /**
+         * Intersect the selected rays with a box, closer than their closest hits
+         * @param box box to test
+         * @param mask selected rays
+         * @return mask of the selected rays that hit the box, a superset of the rays whose closest hit could be in it
+         */
+        [[nodiscard]] uint64_t intersectBox(const BoundingBox &box, uint64_t mask) const;
+    };
+}
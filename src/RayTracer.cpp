@@ -26,20 +26,38 @@ namespace RayTracing {
         return desiredSize / windowSizeF;
     }
 
-    std::vector<Ray> RayTracer::calculateStartingRays(Camera *camera) {
-        const float aspect_ratio = (float) windowSize.getX() / (float) windowSize.getY();
-        const float fov_adjustment = tan((camera->fov * M_PI / 180.0f) / 2.0f);
+    Ray CameraRayGenerator::generate(unsigned x, unsigned y, unsigned sample) const {
+        const Vec2 &offset = offsets[sample];
+
+        Vec3 samplingPixelLocation = {x + offset.getX(), 0, y + offset.getY()};
+        Vec3 pixel = (screen00 + samplingPixelLocation) * viewBoxScaling;
+        Vec3 rayDir = (Vec3::forward() +
+                       Vec3::right() * (pixel.getX() * aspectRatio * fovAdjustment) +
+                       Vec3::up() * (pixel.getZ() * fovAdjustment)
+        ).normalized();
+
+        Ray ray;
+        ray.origin = Vec3{};
+        ray.direction = rayDir;
+        ray.idX = x;
+        ray.idY = y;
+        return ray;
+    }
 
+    CameraRayGenerator RayTracer::cameraRayGenerator(Camera *camera) {
         Vec3 screenOrigin = Vec3::zero();
-        Vec3 screen00 = screenOrigin + Vec3(-(float) windowSize.getX() / 2.0f, 0, -(float) windowSize.getY() / 2.0f);
-
-        Vec3 camForward = Vec3::forward();
-        Vec3 camRight = Vec3::right();
-        Vec3 camUp = Vec3::up();
-
         Vec2 viewBoxScaling = getViewBoxScaling();
-        Vec3 viewBoxScaling3D = {viewBoxScaling.getX(), 1, viewBoxScaling.getY()};
+        return {
+            .screen00 = screenOrigin + Vec3(-(float) windowSize.getX() / 2.0f, 0, -(float) windowSize.getY() / 2.0f),
+            .viewBoxScaling = {viewBoxScaling.getX(), 1, viewBoxScaling.getY()},
+            .aspectRatio = (float) windowSize.getX() / (float) windowSize.getY(),
+            .fovAdjustment = (float) tan((camera->fov * M_PI / 180.0f) / 2.0f),
+            .offsets = getSamplingOffsets()
+        };
+    }
 
+    std::vector<Ray> RayTracer::calculateStartingRays(Camera *camera) {
+        const CameraRayGenerator generator = cameraRayGenerator(camera);
         std::vector<Ray> rays(getRayCount());
 #ifdef DEBUG_INITIAL_RAY_GENERATION
         std::ofstream raysFile("../python/rays.py");
@@ -48,35 +66,20 @@ namespace RayTracing {
         pixelFile << "import numpy" << std::endl << "pixels = numpy.array([" << std::endl;
 #endif
 
-        std::vector<Vec2> offsets = getSamplingOffsets();
-
 //#pragma omp parallel for schedule(static)
-        for (auto y = 0; y < windowSize.getY(); y++) {
-            for (auto x = 0; x < windowSize.getX(); x++) {
-                for (auto s = 0; s < samplesPerPixel; s++) {
-                    const Vec2 &offset = offsets[s];
-
-                    Vec3 samplingPixelLocation = {x + offset.getX(), 0, y + offset.getY()};
-                    Vec3 pixel = (screen00 + samplingPixelLocation) * viewBoxScaling3D;
-                    Vec3 rayDir = (camForward +
-                                   camRight * (pixel.getX() * aspect_ratio * fov_adjustment) +
-                                   camUp * (pixel.getZ() * fov_adjustment)
-                    ).normalized();
-
-                    /// for dynamic vector allocation
-                    // Ray ray = Ray(pixel, rayDir, Vec3::random(), {}, x, y);
-                    // rays.push_back(ray);
-                    /// for preallocated vector
-                    unsigned index = (y * windowSize.getX() + x) * samplesPerPixel + s;
-                    rays[index].origin = Vec3{};
-                    rays[index].direction = rayDir;
+        for (unsigned y = 0; y < windowSize.getY(); y++) {
+            for (unsigned x = 0; x < windowSize.getX(); x++) {
+                for (unsigned s = 0; s < samplesPerPixel; s++) {
+                    size_t index = ((size_t) y * windowSize.getX() + x) * samplesPerPixel + s;
+                    rays[index] = generator.generate(x, y, s);
                     rays[index].rngSeed = Vec3::random();
-                    rays[index].idX = x;
-                    rays[index].idY = y;
-
 
 #ifdef DEBUG_INITIAL_RAY_GENERATION
-                    if (y % 32 == 0 && x % 32 == 0 && offset == offsets[0]) {
+                    if (y % 32 == 0 && x % 32 == 0 && s == 0) {
+                        const Vec2 &offset = generator.offsets[s];
+                        Vec3 pixel = (generator.screen00 + Vec3{x + offset.getX(), 0, y + offset.getY()}) *
+                                     generator.viewBoxScaling;
+                        const Vec3 &rayDir = rays[index].direction;
                         pixelFile << "[" << pixel.getX() << ", " << pixel.getY() << ", " << pixel.z() << "]," <<
                                 std::endl;
                         raysFile << "[" << rayDir.getX() << ", " << rayDir.getY() << ", " << rayDir.z() << "]," <<
@@ -5,6 +5,36 @@
 #include "math/vectors.hpp"
 
 namespace RayTracing {
+    /// Camera parameters needed to generate the camera ray of any pixel sample without storing the rays of the image
+    struct CameraRayGenerator {
+        Vec3 screen00;
+        Vec3 viewBoxScaling;
+        float aspectRatio;
+        float fovAdjustment;
+        /// sampling offset of every sample inside of its pixel
+        std::vector<Vec2> offsets;
+
+        /**
+         * Generate the camera ray of a sample of a pixel, the rng seed is left to the caller
+         * @param x x coordinate of the pixel
+         * @param y y coordinate of the pixel
+         * @param sample index of the sample, less than the samples per pixel
+         * @return ray starting at the camera
+         */
+        [[nodiscard]] Ray generate(unsigned x, unsigned y, unsigned sample) const;
+    };
+
+    /// Settings of the cpu raytracers that only change how the image is traced, independent of scene and hierarchies
+    struct RenderSettings {
+        /// width and height in pixels of the packets camera rays are traced in, 0 traces every ray alone. Bounced rays
+        /// are always traced alone.
+        unsigned rayPacketSize = 0;
+        /// number of threads of the multi-threaded raytracer, 0 uses all hardware threads
+        unsigned threads = 0;
+        /// width and height in pixels of the image tiles the multi-threaded raytracer distributes to its threads
+        unsigned tileSize = 16;
+    };
+
     class RayTracer {
     protected:
         /**
@@ -21,12 +51,20 @@ namespace RayTracing {
          */
         std::vector<Ray> calculateStartingRays(Camera *camera);
 
+        /**
+         * Prepare the generation of single camera rays, used by renderers that do not store all rays at once
+         * @param camera camera to generate rays from
+         * @return generator for the camera rays of every pixel sample
+         */
+        CameraRayGenerator cameraRayGenerator(Camera *camera);
+
         Scene scene;
 
     private:
         Vec2u windowSize;
         unsigned bounces;
         unsigned samplesPerPixel;
+        RenderSettings renderSettings;
         /**
          * For multiple rays per pixel calculate coordinate offsets for samples
          * @return geometrical centered point cloud of length samplesPerPixel
@@ -78,9 +116,15 @@ namespace RayTracing {
         /// Get the number of bounces
         [[nodiscard]] unsigned getBounces() const;
 
-        /// Get the total number of rays to be traced
-        [[nodiscard]] unsigned getRayCount() const {
-            return windowSize.getX() * windowSize.getY() * samplesPerPixel;
+        /// Get the settings of how the cpu raytracers trace the image
+        [[nodiscard]] const RenderSettings &getRenderSettings() const { return renderSettings; }
+
+        /// Set how the cpu raytracers trace the image, ignored by the gpu raytracers
+        void setRenderSettings(const RenderSettings &settings) { renderSettings = settings; }
+
+        /// Get the total number of rays to be traced, 64 bit as large images with many samples exceed 32 bit
+        [[nodiscard]] uint64_t getRayCount() const {
+            return (uint64_t) windowSize.getX() * windowSize.getY() * samplesPerPixel;
         }
     };
 }
\ No newline at end of file
@@ -80,6 +80,10 @@ void Renderer::updateFPS(unsigned fps) {
     this->fps = fps;
 }
 
+void Renderer::updateSPS(unsigned sps) {
+    this->sps = sps;
+}
+
 void Renderer::draw(RayTracing::Image *imageSrc) {
     imageHandler->updateImage(imageSrc);
 
@@ -88,6 +92,12 @@ void Renderer::draw(RayTracing::Image *imageSrc) {
     window->draw(*sprite);
 
     std::ostringstream ss;
+    if (fps > 0) {
+        ss << fps << " fps ";
+    }
+    if (sps > 0) {
+        ss << sps << " samples/s";
+    }
     statusText->setString(ss.str());
     window->draw(*statusText);
     window->display();
@@ -69,6 +69,9 @@ public:
     /// Updates the FPS display
     void updateFPS(unsigned fps);
 
+    /// Updates the samples per second display, 0 hides it
+    void updateSPS(unsigned sps);
+
     /// Save the current window content to the specified path
     bool saveWindow(const std::string &path);
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "Scene.hpp"
 
+#include <chrono>
 #include <iostream>
+#include <unordered_map>
+
+#include "bvh/BVHCache.hpp"
 
 namespace RayTracing {
     Scene Scene::loadFromFile(const std::string &path) {
@@ -16,9 +20,39 @@ namespace RayTracing {
         scene.fileName = path;
         scene.camera = new Camera(serializableScene.camera);
         std::string baseDir = path.substr(0, path.find_last_of('/'));
-        for (auto &object: serializableScene.objects) {
-            auto loadedObj = new MeshedRayTraceableObject(object);
-            loadedObj->loadMesh(baseDir);
+        // every mesh file is loaded once, objects referencing the same content share the mesh of the first object
+        std::unordered_map<std::string, uint64_t> fileHashes;
+        std::unordered_map<uint64_t, MeshedRayTraceableObject *> loadedMeshes;
+        for (unsigned i = 0; i < serializableScene.objects.size(); i++) {
+            auto loadedObj = new MeshedRayTraceableObject(serializableScene.objects[i]);
+            const auto &objectData = data["objects"][i];
+            if (objectData.contains("animation")) {
+                loadedObj->animation = Animation::fromJson(objectData["animation"], loadedObj->transform);
+            }
+
+            if (!loadedObj->animation.morphTarget.empty()) {
+                // morph targets deform the vertices, the object needs a mesh of its own
+                loadedObj->loadMesh(baseDir);
+                loadedObj->loadMorphTarget(baseDir);
+            } else {
+                std::string meshPath = baseDir + "/" + loadedObj->fileName;
+                if (!fileHashes.contains(meshPath)) {
+                    fileHashes[meshPath] = BVHCache::hashFile(meshPath);
+                }
+                uint64_t hash = fileHashes[meshPath];
+                if (hash != 0 && loadedMeshes.contains(hash)) {
+                    loadedObj->shareGeometry(*loadedMeshes[hash]);
+                } else {
+                    loadedObj->loadMesh(baseDir);
+                    loadedObj->meshHash = hash;
+                    if (hash != 0) {
+                        loadedMeshes[hash] = loadedObj;
+                    }
+                }
+            }
+            if (loadedObj->animation.isAnimated()) {
+                loadedObj->applyFrame(0);
+            }
             scene.objects.push_back(loadedObj);
         }
         for (auto &sphere: serializableScene.spheres) {
@@ -35,19 +69,73 @@ namespace RayTracing {
     void Scene::prepareRender() {
         if (prepared) return;
         for (auto &object: objects) {
-            object->updateBoundingBox();
             object->transform.update();
-            unsigned maxTriangleCount = object->mesh->numTriangles;
-            if (maxTriangleCount > 500) {
-                maxTriangleCount /= 2;
-            }
-            if (maxTriangleCount > 4000) {
-                maxTriangleCount /= 2;
+            if (object->instanceOf != nullptr) {
+                // owners come before their instances and are already built
+                object->shareGeometry(*object->instanceOf);
+            } else {
+                object->updateBoundingBox();
+                auto buildStart = std::chrono::high_resolution_clock::now();
+                object->updateNestedBoundingBox(bvhBuildSettings);
+                bvhBuildMillis += std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - buildStart).count();
+                bvhCacheHits += object->loadedFromCache;
             }
-            object->updateNestedBoundingBox(maxTriangleCount + 1);
-            nestingDepth = std::max(nestingDepth, (int) object->nestedBoundingBox->depth());
-            triangleCount += object->mesh->numTriangles;
+            bvhSAHCost += object->linearBVH->sahCost(bvhBuildSettings.traversalCost,
+                                                     bvhBuildSettings.intersectionCost);
+            nestingDepth = std::max(nestingDepth, (int) object->linearBVH->getDepth());
+            triangleCount += object->mesh->fileTriangleCount;
         }
+        topLevelBVH.build(objects, spheres, lights);
         prepared = true;
     }
+
+    unsigned Scene::frameCount() const {
+        unsigned frames = 1;
+        for (const auto &object: objects) {
+            frames = std::max(frames, object->animation.frameCount());
+        }
+        return frames;
+    }
+
+    void Scene::setFrame(unsigned frame) {
+        bvhBuildMillis = 0;
+        bvhRefitCount = 0;
+        bvhRebuildCount = 0;
+        bool moved = false;
+        auto updateStart = std::chrono::high_resolution_clock::now();
+        for (auto &object: objects) {
+            if (!object->animation.isAnimated()) {
+                continue;
+            }
+            moved = true;
+            bool deformed = object->applyFrame(frame);
+            object->transform.update();
+            if (prepared && deformed) {
+                bvhRefitCount++;
+                if (object->refitNestedBoundingBox(bvhBuildSettings)) {
+                    bvhRebuildCount++;
+                }
+            }
+        }
+        if (!prepared) {
+            return;
+        }
+        if (moved) {
+            bvhRefitCount++;
+            if (topLevelBVH.refit(objects, spheres, lights, bvhBuildSettings.refitRebuildThreshold)) {
+                bvhRebuildCount++;
+            }
+        }
+        bvhBuildMillis = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - updateStart).count();
+
+        bvhSAHCost = 0;
+        nestingDepth = -1;
+        for (const auto &object: objects) {
+            bvhSAHCost += object->linearBVH->sahCost(bvhBuildSettings.traversalCost,
+                                                     bvhBuildSettings.intersectionCost);
+            nestingDepth = std::max(nestingDepth, (int) object->linearBVH->getDepth());
+        }
+    }
 }
@@ -9,6 +9,7 @@
 #include "raytrace_objects/LightSource.hpp"
 #include "raytrace_objects/MeshedRayTraceableObject.hpp"
 #include "raytrace_objects/SphereRayTraceableObject.hpp"
+#include "bvh/TopLevelBVH.hpp"
 
 namespace RayTracing {
     struct SerializableScene {
@@ -24,6 +25,11 @@ namespace RayTracing {
     private:
         int nestingDepth = -1;
         long triangleCount = -1;
+        double bvhBuildMillis = 0;
+        float bvhSAHCost = 0;
+        unsigned bvhRefitCount = 0;
+        unsigned bvhRebuildCount = 0;
+        unsigned bvhCacheHits = 0;
         bool prepared = false;
 
     public:
@@ -32,6 +38,10 @@ namespace RayTracing {
         std::vector<SphereRayTraceableObject *> spheres;
         std::vector<LightSource *> lights;
         std::string fileName{};
+        /// settings used to build the nested bounding boxes of the meshes in prepareRender
+        BVHBuildSettings bvhBuildSettings{};
+        /// hierarchy over all meshes, spheres and lights, built in prepareRender
+        TopLevelBVH topLevelBVH{};
 
     public:
         Scene() = default;
@@ -44,7 +54,8 @@ namespace RayTracing {
         }
 
         /**
-         * Load a scene from a file
+         * Load a scene from a file. Objects referencing mesh files with the same content share the mesh and the
+         * hierarchies of the first of them, only objects deformed by a morph target load a mesh of their own.
          * @param path Path to the scene file
          * @return The loaded scene
          */
@@ -72,6 +83,21 @@ namespace RayTracing {
          */
         void prepareRender();
 
+        /**
+         * Get the number of frames of the animations of all objects
+         * @return 1 for static scenes
+         */
+        [[nodiscard]] unsigned frameCount() const;
+
+        /**
+         * Move all animated objects to a frame.
+         * If the scene is prepared, the hierarchies of deformed meshes and the top level hierarchy are refit and only
+         * rebuilt if their SAH cost degraded by more than bvhBuildSettings.refitRebuildThreshold. Build time and SAH
+         * cost then only cover this update.
+         * @param frame frame to move to
+         */
+        void setFrame(unsigned frame);
+
         /**
          * Get the maximum nesting depth of bounding boxes in the scene
          * @return -1 if not prepared, else the nesting depth
@@ -87,5 +113,36 @@ namespace RayTracing {
         [[nodiscard]] long getTriangleCount() const {
             return triangleCount;
         }
+
+        /**
+         * Get the time spent building and flattening the bounding volume hierarchies of all meshes
+         * @return 0 if not prepared, else the build time in milliseconds
+         */
+        [[nodiscard]] double getBVHBuildMillis() const {
+            return bvhBuildMillis;
+        }
+
+        /**
+         * Get the sum of the surface area heuristic costs of the hierarchies of all meshes
+         * @return 0 if not prepared, else the SAH cost
+         */
+        [[nodiscard]] float getBVHSAHCost() const {
+            return bvhSAHCost;
+        }
+
+        /// Get the number of mesh hierarchies prepareRender loaded from the cache instead of building them
+        [[nodiscard]] unsigned getBVHCacheHits() const {
+            return bvhCacheHits;
+        }
+
+        /// Get the number of hierarchies refit by the last setFrame
+        [[nodiscard]] unsigned getBVHRefitCount() const {
+            return bvhRefitCount;
+        }
+
+        /// Get the number of hierarchies rebuilt by the last setFrame because a refit degraded them too much
+        [[nodiscard]] unsigned getBVHRebuildCount() const {
+            return bvhRebuildCount;
+        }
     };
 }
\ No newline at end of file
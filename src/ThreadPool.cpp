@@ -0,0 +1,102 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace RayTracing {
+    ThreadPool::ThreadPool(unsigned threadCount)
+        : queues(threadCount > 0 ? threadCount : std::max(std::thread::hardware_concurrency(), 1u)) {
+        for (unsigned thread = 1; thread < queues.size(); thread++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, thread);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(unsigned count, const std::function<void(unsigned index, unsigned thread)> &task) {
+        if (count == 0) {
+            return;
+        }
+        // workers still leaving the last loop may already pick up indices of this one, so the task has to be set
+        // before the queues are filled
+        this->task = &task;
+        remaining.store(count, std::memory_order_relaxed);
+        const unsigned threads = threadCount();
+        for (unsigned thread = 0; thread < threads; thread++) {
+            unsigned first = (uint64_t) count * thread / threads;
+            unsigned last = (uint64_t) count * (thread + 1) / threads;
+            std::lock_guard lock(queues[thread].mutex);
+            for (unsigned index = first; index < last; index++) {
+                queues[thread].indices.push_back(index);
+            }
+        }
+        {
+            std::lock_guard lock(mutex);
+            generation++;
+        }
+        wake.notify_all();
+
+        runTasks(0);
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&] { return remaining.load(std::memory_order_acquire) == 0; });
+        this->task = nullptr;
+    }
+
+    void ThreadPool::workerLoop(unsigned thread) {
+        unsigned seenGeneration = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) {
+                    return;
+                }
+                seenGeneration = generation;
+            }
+            runTasks(thread);
+        }
+    }
+
+    void ThreadPool::runTasks(unsigned thread) {
+        unsigned index;
+        while (nextTask(thread, index)) {
+            (*task)(index, thread);
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    bool ThreadPool::nextTask(unsigned thread, unsigned &index) {
+        {
+            TaskQueue &own = queues[thread];
+            std::lock_guard lock(own.mutex);
+            if (!own.indices.empty()) {
+                index = own.indices.front();
+                own.indices.pop_front();
+                return true;
+            }
+        }
+        // steal the index farthest away from what the victim works on next
+        for (unsigned offset = 1; offset < threadCount(); offset++) {
+            TaskQueue &victim = queues[(thread + offset) % threadCount()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.indices.empty()) {
+                index = victim.indices.back();
+                victim.indices.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RayTracing {
+    /**
+     * Pool of worker threads running parallel loops with work stealing.
+     * The indices of a loop are split into one contiguous range per thread, every thread takes its next index from
+     * the front of its own deque and steals from the back of the others once it is empty, so neighbouring indices
+     * stay on one thread while the load still evens out. The threads are kept between loops.
+     */
+    class ThreadPool {
+    private:
+        /// indices a thread still has to run, locked as threads steal from each other
+        struct TaskQueue {
+            std::mutex mutex;
+            std::deque<unsigned> indices;
+        };
+
+        std::vector<std::thread> workers;
+        /// one queue per thread, the calling thread of parallelFor uses the first one
+        std::vector<TaskQueue> queues;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        /// incremented for every loop, workers run the loop once they see a new generation
+        unsigned generation = 0;
+        bool stopping = false;
+        /// task of the running loop
+        const std::function<void(unsigned index, unsigned thread)> *task = nullptr;
+        /// indices of the running loop that are not finished yet
+        std::atomic<unsigned> remaining{0};
+
+        /// Wait for loops and run their indices until the pool is destroyed
+        void workerLoop(unsigned thread);
+
+        /// Run indices of the current loop until all queues are empty
+        void runTasks(unsigned thread);
+
+        /**
+         * Take the next index from the own queue or steal one from another thread
+         * @param thread thread taking the index
+         * @param index set to the taken index
+         * @return false if all queues are empty
+         */
+        bool nextTask(unsigned thread, unsigned &index);
+
+    public:
+        /**
+         * Start the worker threads
+         * @param threadCount number of threads running a loop including the calling thread, 0 uses all hardware
+         * threads
+         */
+        explicit ThreadPool(unsigned threadCount = 0);
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool();
+
+        /// Get the number of threads running a loop, including the calling thread
+        [[nodiscard]] unsigned threadCount() const { return queues.size(); }
+
+        /**
+         * Run a task for every index in [0, count) on all threads and wait until all of them are finished. The
+         * calling thread takes part as thread 0.
+         * @param count number of indices
+         * @param task called with the index and the thread running it, less than threadCount()
+         */
+        void parallelFor(unsigned count, const std::function<void(unsigned index, unsigned thread)> &task);
+    };
+}
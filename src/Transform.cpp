@@ -1,6 +1,18 @@
 #include "Transform.hpp"
 
 namespace RayTracing {
+    /// Copy the first Rows rows and Columns columns of a 4x4 matrix
+    template<unsigned Rows, unsigned Columns>
+    static Matrix<Rows, Columns, float> upperPart(const Mat4x4 &matrix) {
+        Matrix<Rows, Columns, float> part;
+        for (unsigned row = 0; row < Rows; row++) {
+            for (unsigned column = 0; column < Columns; column++) {
+                part.setValue(row, column, matrix[row][column]);
+            }
+        }
+        return part;
+    }
+
     Mat4x4 Transform::calcTranslationMatrix(const Vec3 &translation) {
         return Mat4x4({
             {1, 0, 0, translation.getX()},
@@ -99,22 +111,60 @@ namespace RayTracing {
         inverseTranslationMatrix = calcInverseTranslationMatrix();
         transformationMatrix = translationMatrix * rotationMatrix * scaleMatrix;
         inverseTransformationMatrix = inverseScaleMatrix * inverseRotationMatrix * inverseTranslationMatrix;
+        // the inverse rotation is built from the negated angles, its exact inverse is the transpose
+        localToWorldMatrix = translationMatrix * inverseRotationMatrix.transposed() * scaleMatrix;
+
+        worldToLocal = upperPart<3, 4>(inverseTransformationMatrix);
+        localToWorld = upperPart<3, 4>(localToWorldMatrix);
+        objectToWorld = upperPart<3, 4>(transformationMatrix);
+        directionToLocal = upperPart<3, 3>(inverseRotationMatrix * inverseScaleMatrix);
+        normalToWorld = upperPart<3, 3>(rotationMatrix);
+        if (rotation != Vec3(0.0f) || scale != Vec3(1.0f)) {
+            kind = Kind::AFFINE;
+        } else {
+            kind = position == Vec3(0.0f) ? Kind::IDENTITY : Kind::TRANSLATION;
+        }
     }
 
     Vec3 Transform::getTransformedPosition(const Vec3 &pos) const {
-        return (transformationMatrix * Vec4(pos, 1)).cutoff();
+        switch (kind) {
+            case Kind::IDENTITY:
+                return pos;
+            case Kind::TRANSLATION:
+                return pos + position;
+            default:
+                return objectToWorld * Vec4(pos, 1);
+        }
     }
 
     Vec3 Transform::getTransformedNormal(const Vec3 &pos) const {
-        return (rotationMatrix * Vec4(pos, 1)).cutoff();
+        return kind == Kind::AFFINE ? normalToWorld * pos : pos;
     }
 
     Vec3 Transform::getTransformedRayDirection(const Vec3 &dir) const {
-        return (inverseRotationMatrix * inverseScaleMatrix * Vec4(dir, 1)).cutoff();
+        return kind == Kind::AFFINE ? directionToLocal * dir : dir;
     }
 
     Vec3 Transform::getInverseTransformedPosition(const Vec3 &pos) const {
-        return (inverseTransformationMatrix * Vec4(pos, 1)).cutoff();
+        switch (kind) {
+            case Kind::IDENTITY:
+                return pos;
+            case Kind::TRANSLATION:
+                return pos - position;
+            default:
+                return worldToLocal * Vec4(pos, 1);
+        }
+    }
+
+    Vec3 Transform::getLocalToWorldPosition(const Vec3 &pos) const {
+        switch (kind) {
+            case Kind::IDENTITY:
+                return pos;
+            case Kind::TRANSLATION:
+                return pos + position;
+            default:
+                return localToWorld * Vec4(pos, 1);
+        }
     }
 
     Mat4x4 Transform::getTransformMatrix() const {
@@ -1,8 +1,17 @@
 #pragma once
+#include <cstdint>
+
 #include "math/matrices.hpp"
 
 namespace RayTracing {
     struct Transform {
+        /// Shape of a transform, identity and translation-only transforms skip the matrix products
+        enum class Kind : uint8_t {
+            IDENTITY,
+            TRANSLATION,
+            AFFINE
+        };
+
     private:
         Mat4x4 transformationMatrix{};
         Mat4x4 inverseTransformationMatrix{};
@@ -12,6 +21,18 @@ namespace RayTracing {
         Mat4x4 inverseScaleMatrix;
         Mat4x4 translationMatrix{};
         Mat4x4 inverseTranslationMatrix{};
+        /// exact inverse of inverseTransformationMatrix, maps local positions back to the world
+        Mat4x4 localToWorldMatrix{};
+        /// upper three rows of the matrices above baked by update, the homogeneous row of an affine transform is
+        /// always 0 0 0 1 and does not need to be multiplied
+        Mat3x4 worldToLocal{};
+        Mat3x4 localToWorld{};
+        Mat3x4 objectToWorld{};
+        /// inverse rotation times inverse scale, maps world ray directions into local space
+        Mat3x3 directionToLocal{};
+        /// rotation applied to local normals
+        Mat3x3 normalToWorld{};
+        Kind kind = Kind::AFFINE;
         Vec3 position{};
         //Quaternion quaternion;
         Vec3 rotation{};
@@ -36,6 +57,7 @@ namespace RayTracing {
 
         void setRotation(const Vec3 &rotation);
 
+        /// Recalculate all matrices from position, rotation and scale, has to be called after changing them
         void update();
 
         [[nodiscard]] Mat4x4 getTransformMatrix() const;
@@ -52,6 +74,9 @@ namespace RayTracing {
 
         [[nodiscard]] Vec3 getInverseTransformedPosition(const Vec3 &pos) const;
 
+        /// Map a local position to the world position that getInverseTransformedPosition maps onto it
+        [[nodiscard]] Vec3 getLocalToWorldPosition(const Vec3 &pos) const;
+
         [[nodiscard]] Vec3 getTransformedNormal(const Vec3 &pos) const;
 
         [[nodiscard]] Vec3 getTransformedRayDirection(const Vec3 &dir) const;
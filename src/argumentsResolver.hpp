@@ -15,6 +15,15 @@ extern std::string benchmarkFile;
 extern unsigned bounces;
 extern unsigned samples;
 extern RayTracing::Vec2u windowSize;
+extern RayTracing::BVHBuildSettings bvhBuildSettings;
+extern RayTracing::RenderSettings renderSettings;
+extern bool bvhBuildBenchmark;
+extern bool bvhLayoutBenchmark;
+extern bool renderSequence;
+extern bool bvhStatistics;
+extern bool progressive;
+extern float adaptiveError;
+extern std::string sampleCountFile;
 
 /**
  * Resolve command line arguments and set global variables accordingly
@@ -38,11 +47,57 @@ inline void decodeArguments(int argc, char *argv[]) {
                     std::endl;
             std::cout << "\t--multi-threaded\t\t use the multi-threaded cpu raytracer implementation" << std::endl;
             std::cout << "\t--shader\t\t\t use the gpu raytracer implementation (default)" << std::endl;
+            std::cout << "\t--wavefront\t\t\t use the multi-threaded cpu raytracer tracing all rays bounce by bounce"
+                    << std::endl;
             std::cout << "\t--bounces <num>\t\t\t specify number of bounces (default: " << bounces << ")" << std::endl;
             std::cout << "\t--samples <num>\t\t\t specify number of samples per pixel (default: " << samples << ")" <<
                     std::endl;
             std::cout << "\t--window-size <width> <height>\t specify window size (default: " << windowSize.getX() << "x"
                     << windowSize.getY() << ")" << std::endl;
+            std::cout << "\t--bvh-builder <midpoint|sah|lbvh|sbvh> specify the bounding volume hierarchy builder "
+                    "(default: " << RayTracing::BVHBuildSettings::builderName(bvhBuildSettings.builder) << ")" <<
+                    std::endl;
+            std::cout << "\t--bvh-quality <fast|medium|high> select a bounding volume hierarchy build preset, fast "
+                    "uses the lbvh builder, medium and high the sah builder with 16 and 32 bins" << std::endl;
+            std::cout << "\t--bvh-morton-bits <30|63>\t specify the morton code length of the lbvh builder (default: "
+                    << bvhBuildSettings.mortonCodeBits << ")" << std::endl;
+            std::cout << "\t--bvh-split-budget <fraction>\t specify how many triangle references the sbvh builder may "
+                    "add, relative to the triangle count (default: " << bvhBuildSettings.sbvhDuplicateBudget << ")" <<
+                    std::endl;
+            std::cout << "\t--bvh-layout <binary|bvh4|bvh8|bvh4q8|bvh4q16|bvh8q8|bvh8q16> specify the node layout of the "
+                    "bounding volume hierarchy, q8 and q16 quantize the child bounds to 8 or 16 bits "
+                    "(default: " << RayTracing::BVHBuildSettings::layoutName(bvhBuildSettings.layout) << ")" <<
+                    std::endl;
+            std::cout << "\t--ray-packets <0|4|8>\t\t trace camera rays in packets of 4x4 or 8x8 pixels through the "
+                    "hierarchies on the cpu, 0 traces every ray alone (default: " << renderSettings.rayPacketSize <<
+                    ")" << std::endl;
+            std::cout << "\t--threads <num>\t\t\t specify number of threads of the multi-threaded cpu raytracer "
+                    "(default: all available)" << std::endl;
+            std::cout << "\t--tile-size <pixels>\t\t specify width and height of the image tiles the multi-threaded "
+                    "cpu raytracer distributes to its threads (default: " << renderSettings.tileSize << ")" <<
+                    std::endl;
+            std::cout << "\t--bvh-rebuild-threshold <factor> specify the growth of the SAH cost at which a refit "
+                    "hierarchy is rebuilt (default: " << bvhBuildSettings.refitRebuildThreshold << ")" << std::endl;
+            std::cout << "\t--bvh-cache <dir>\t\t specify the directory of the bounding volume hierarchy cache "
+                    "(default: .bvhcache next to each mesh)" << std::endl;
+            std::cout << "\t--no-bvh-cache\t\t\t always build the bounding volume hierarchies, neither load nor "
+                    "store them in the cache" << std::endl;
+            std::cout << "\t--bvh-build-threads <num>\t specify number of threads building the bounding volume "
+                    "hierarchy (default: all available)" << std::endl;
+            std::cout << "\t--bvh-build-benchmark\t\t benchmark the bounding volume hierarchy build for increasing "
+                    "thread counts instead of rendering" << std::endl;
+            std::cout << "\t--bvh-layout-benchmark\t\t render the scene once per node layout and compare memory and "
+                    "ray throughput of the compressed layouts" << std::endl;
+            std::cout << "\t--bvh-stats\t\t\t print node, leaf and memory statistics of the bounding volume "
+                    "hierarchies and the tests per ray after rendering, appended to bvhstats.jsonl" << std::endl;
+            std::cout << "\t--progressive\t\t\t render one sample per pixel per pass on the cpu and show the running "
+                    "average in the window after every pass, closing the window stops the render" << std::endl;
+            std::cout << "\t--adaptive <error>\t\t render progressively and stop sampling pixels once the standard "
+                    "error of their luminance is below error, the saved samples go to the noisy pixels" << std::endl;
+            std::cout << "\t--sample-count-image <file>\t save the samples per pixel of a progressive render as "
+                    "grayscale image, white for the most samples" << std::endl;
+            std::cout << "\t--sequence\t\t\t render every frame of the scene animation, the frame number is "
+                    "appended to the output file" << std::endl;
         } else if (arg == "--no-window") {
             openWindow = false;
         } else if (arg == "-of") {
@@ -71,6 +126,8 @@ inline void decodeArguments(int argc, char *argv[]) {
             implementation = RayTracing::MULTI_THREADED;
         } else if (arg == "--shader") {
             implementation = RayTracing::SHADER_BASED;
+        } else if (arg == "--wavefront") {
+            implementation = RayTracing::WAVEFRONT;
         } else if (arg == "--bounces") {
             if (argc < i + 1) {
                 std::cerr << "Missing argument for --bounces" << std::endl;
@@ -91,6 +148,121 @@ inline void decodeArguments(int argc, char *argv[]) {
             unsigned height = std::stoi(argv[i + 2]);
             windowSize = RayTracing::Vec2u(width, height);
             i += 2;
+        } else if (arg == "--bvh-builder") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-builder" << std::endl;
+            }
+            if (!RayTracing::BVHBuildSettings::parseBuilderType(argv[i + 1], bvhBuildSettings.builder)) {
+                std::cerr << "Unknown bvh builder " << argv[i + 1] << std::endl;
+            }
+            i++;
+        } else if (arg == "--bvh-quality") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-quality" << std::endl;
+            }
+            RayTracing::BVHBuildQuality quality;
+            if (RayTracing::BVHBuildSettings::parseQuality(argv[i + 1], quality)) {
+                bvhBuildSettings.applyQuality(quality);
+            } else {
+                std::cerr << "Unknown bvh quality " << argv[i + 1] << std::endl;
+            }
+            i++;
+        } else if (arg == "--bvh-morton-bits") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-morton-bits" << std::endl;
+            }
+            unsigned mortonCodeBits = std::stoi(argv[i + 1]);
+            if (mortonCodeBits == 30 || mortonCodeBits == 63) {
+                bvhBuildSettings.mortonCodeBits = mortonCodeBits;
+            } else {
+                std::cerr << "Unsupported morton code length " << argv[i + 1] << ", use 30 or 63" << std::endl;
+            }
+            i++;
+        } else if (arg == "--bvh-split-budget") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-split-budget" << std::endl;
+            }
+            bvhBuildSettings.sbvhDuplicateBudget = std::stof(argv[i + 1]);
+            i++;
+        } else if (arg == "--bvh-layout") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-layout" << std::endl;
+            }
+            if (!RayTracing::BVHBuildSettings::parseLayout(argv[i + 1], bvhBuildSettings.layout)) {
+                std::cerr << "Unknown bvh layout " << argv[i + 1] << std::endl;
+            }
+            i++;
+        } else if (arg == "--ray-packets") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --ray-packets" << std::endl;
+            }
+            unsigned packetSize = std::stoi(argv[i + 1]);
+            if (packetSize == 0 || packetSize == 4 || packetSize == 8) {
+                renderSettings.rayPacketSize = packetSize;
+            } else {
+                std::cerr << "Unsupported ray packet size " << argv[i + 1] << ", use 0, 4 or 8" << std::endl;
+            }
+            i++;
+        } else if (arg == "--threads") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --threads" << std::endl;
+            }
+            renderSettings.threads = std::stoi(argv[i + 1]);
+            i++;
+        } else if (arg == "--tile-size") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --tile-size" << std::endl;
+            }
+            unsigned tileSize = std::stoi(argv[i + 1]);
+            if (tileSize > 0) {
+                renderSettings.tileSize = tileSize;
+            } else {
+                std::cerr << "Unsupported tile size " << argv[i + 1] << ", use at least 1" << std::endl;
+            }
+            i++;
+        } else if (arg == "--bvh-rebuild-threshold") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-rebuild-threshold" << std::endl;
+            }
+            bvhBuildSettings.refitRebuildThreshold = std::stof(argv[i + 1]);
+            i++;
+        } else if (arg == "--bvh-cache") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-cache" << std::endl;
+            }
+            bvhBuildSettings.cacheDirectory = argv[i + 1];
+            i++;
+        } else if (arg == "--no-bvh-cache") {
+            bvhBuildSettings.useCache = false;
+        } else if (arg == "--bvh-build-threads") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --bvh-build-threads" << std::endl;
+            }
+            bvhBuildSettings.buildThreads = std::stoi(argv[i + 1]);
+            i++;
+        } else if (arg == "--bvh-build-benchmark") {
+            bvhBuildBenchmark = true;
+        } else if (arg == "--bvh-layout-benchmark") {
+            bvhLayoutBenchmark = true;
+        } else if (arg == "--bvh-stats") {
+            bvhStatistics = true;
+        } else if (arg == "--sequence") {
+            renderSequence = true;
+        } else if (arg == "--progressive") {
+            progressive = true;
+        } else if (arg == "--adaptive") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --adaptive" << std::endl;
+            }
+            adaptiveError = std::stof(argv[i + 1]);
+            progressive = true;
+            i++;
+        } else if (arg == "--sample-count-image") {
+            if (argc < i + 1) {
+                std::cerr << "Missing argument for --sample-count-image" << std::endl;
+            }
+            sampleCountFile = argv[i + 1];
+            i++;
         }
     }
 }
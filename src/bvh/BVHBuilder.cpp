@@ -0,0 +1,189 @@
+#include "BVHBuilder.hpp"
+
+#include <omp.h>
+
+#include "LBVHBuilder.hpp"
+#include "MidpointBVHBuilder.hpp"
+#include "SAHBVHBuilder.hpp"
+#include "SBVHBuilder.hpp"
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    bool BVHBuildSettings::parseBuilderType(const std::string &name, BVHBuilderType &type) {
+        if (name == "midpoint") {
+            type = BVHBuilderType::MIDPOINT;
+            return true;
+        }
+        if (name == "sah") {
+            type = BVHBuilderType::SAH;
+            return true;
+        }
+        if (name == "lbvh") {
+            type = BVHBuilderType::LBVH;
+            return true;
+        }
+        if (name == "sbvh") {
+            type = BVHBuilderType::SBVH;
+            return true;
+        }
+        return false;
+    }
+
+    std::string BVHBuildSettings::builderName(BVHBuilderType type) {
+        switch (type) {
+            case BVHBuilderType::MIDPOINT:
+                return "midpoint";
+            case BVHBuilderType::SAH:
+                return "sah";
+            case BVHBuilderType::LBVH:
+                return "lbvh";
+            case BVHBuilderType::SBVH:
+                return "sbvh";
+            default:
+                return "unknown";
+        }
+    }
+
+    bool BVHBuildSettings::parseQuality(const std::string &name, BVHBuildQuality &quality) {
+        if (name == "fast") {
+            quality = BVHBuildQuality::FAST;
+            return true;
+        }
+        if (name == "medium") {
+            quality = BVHBuildQuality::MEDIUM;
+            return true;
+        }
+        if (name == "high") {
+            quality = BVHBuildQuality::HIGH;
+            return true;
+        }
+        return false;
+    }
+
+    bool BVHBuildSettings::parseLayout(const std::string &name, BVHLayout &layout) {
+        if (name == "binary") {
+            layout = BVHLayout::BINARY;
+            return true;
+        }
+        if (name == "bvh4") {
+            layout = BVHLayout::BVH4;
+            return true;
+        }
+        if (name == "bvh8") {
+            layout = BVHLayout::BVH8;
+            return true;
+        }
+        if (name == "bvh4q8") {
+            layout = BVHLayout::BVH4_Q8;
+            return true;
+        }
+        if (name == "bvh4q16") {
+            layout = BVHLayout::BVH4_Q16;
+            return true;
+        }
+        if (name == "bvh8q8") {
+            layout = BVHLayout::BVH8_Q8;
+            return true;
+        }
+        if (name == "bvh8q16") {
+            layout = BVHLayout::BVH8_Q16;
+            return true;
+        }
+        return false;
+    }
+
+    std::string BVHBuildSettings::layoutName(BVHLayout layout) {
+        switch (layout) {
+            case BVHLayout::BINARY:
+                return "binary";
+            case BVHLayout::BVH4:
+                return "bvh4";
+            case BVHLayout::BVH8:
+                return "bvh8";
+            case BVHLayout::BVH4_Q8:
+                return "bvh4q8";
+            case BVHLayout::BVH4_Q16:
+                return "bvh4q16";
+            case BVHLayout::BVH8_Q8:
+                return "bvh8q8";
+            case BVHLayout::BVH8_Q16:
+                return "bvh8q16";
+            default:
+                return "unknown";
+        }
+    }
+
+    void BVHBuildSettings::applyQuality(BVHBuildQuality quality) {
+        switch (quality) {
+            case BVHBuildQuality::FAST:
+                builder = BVHBuilderType::LBVH;
+                mortonCodeBits = 30;
+                break;
+            case BVHBuildQuality::MEDIUM:
+                builder = BVHBuilderType::SAH;
+                sahBinCount = 16;
+                break;
+            case BVHBuildQuality::HIGH:
+                builder = BVHBuilderType::SAH;
+                sahBinCount = 32;
+                break;
+        }
+    }
+
+    BVHBuilder *BVHBuilder::create(const BVHBuildSettings &settings) {
+        switch (settings.builder) {
+            case BVHBuilderType::MIDPOINT:
+                return new MidpointBVHBuilder(settings);
+            case BVHBuilderType::LBVH:
+                return new LBVHBuilder(settings);
+            case BVHBuilderType::SBVH:
+                return new SBVHBuilder(settings);
+            case BVHBuilderType::SAH:
+            default:
+                return new SAHBVHBuilder(settings);
+        }
+    }
+
+    unsigned BVHBuilder::buildThreadCount() const {
+        return settings.buildThreads == 0 ? (unsigned) omp_get_max_threads() : settings.buildThreads;
+    }
+
+    BoundingBox BVHBuilder::calculateBoundingBoxForTriangles(const Mesh &mesh, const std::vector<unsigned> &triangles) {
+        Vec3 minLoc = {INFINITY, INFINITY, INFINITY};
+        Vec3 maxLoc = {-INFINITY, -INFINITY, -INFINITY};
+        for (auto triangle: triangles) {
+            for (int i = 0; i < 3; i++) {
+                Vec3 v = mesh.vertices[mesh.indices[triangle * 3 + i]];
+                minLoc = Vec3(std::min(minLoc.getX(), v.getX()), std::min(minLoc.getY(), v.getY()),
+                              std::min(minLoc.getZ(), v.getZ()));
+                maxLoc = Vec3(std::max(maxLoc.getX(), v.getX()), std::max(maxLoc.getY(), v.getY()),
+                              std::max(maxLoc.getZ(), v.getZ()));
+            }
+        }
+        return {minLoc, maxLoc};
+    }
+
+    /// Append the triangles of all leaves below box to ordered in depth first order and update their offsets
+    static void appendLeavesDepthFirst(NestedBoundingBox *box, const std::vector<unsigned> &triangleOrder,
+                                       std::vector<unsigned> &ordered) {
+        if (box->left == nullptr || box->right == nullptr) {
+            unsigned offset = ordered.size();
+            ordered.insert(ordered.end(), triangleOrder.begin() + box->trianglesOffset,
+                           triangleOrder.begin() + box->trianglesOffset + box->triangleCount);
+            box->trianglesOffset = offset;
+            return;
+        }
+        appendLeavesDepthFirst(box->left, triangleOrder, ordered);
+        appendLeavesDepthFirst(box->right, triangleOrder, ordered);
+    }
+
+    void BVHBuilder::orderLeavesDepthFirst(NestedBoundingBox *root, std::vector<unsigned> &triangleOrder) {
+        if (root == nullptr) {
+            return;
+        }
+        std::vector<unsigned> ordered;
+        ordered.reserve(triangleOrder.size());
+        appendLeavesDepthFirst(root, triangleOrder, ordered);
+        triangleOrder = std::move(ordered);
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "../raytrace_objects/BoundigBox.hpp"
+
+namespace RayTracing {
+    struct Mesh;
+
+    /// Available strategies to build the nested bounding box hierarchy of a mesh
+    enum class BVHBuilderType {
+        /// split at the center of the longest axis, triangles straddling the split are copied into both children
+        MIDPOINT,
+        /// binned surface area heuristic, split axis, split position and leaf creation are chosen by cost
+        SAH,
+        /// linear bvh, triangles sorted by the Morton code of their centroid, fastest build but lower quality
+        LBVH,
+        /// spatial split SAH, triangle references may be clipped into several children within a duplication budget
+        SBVH
+    };
+
+    /// Node layouts the hierarchy of a mesh can be traversed in
+    enum class BVHLayout {
+        /// binary nodes, two children per node
+        BINARY,
+        /// four children per node, tested with one SIMD pass
+        BVH4,
+        /// eight children per node, tested with one SIMD pass
+        BVH8,
+        /// BVH4 with child bounds quantized to 8 bits relative to the parent node
+        BVH4_Q8,
+        /// BVH4 with child bounds quantized to 16 bits relative to the parent node
+        BVH4_Q16,
+        /// BVH8 with child bounds quantized to 8 bits relative to the parent node
+        BVH8_Q8,
+        /// BVH8 with child bounds quantized to 16 bits relative to the parent node
+        BVH8_Q16
+    };
+
+    /// Build quality presets trading build time for traversal performance
+    enum class BVHBuildQuality {
+        /// LBVH builder with 30 bit Morton codes, for scenes that are rebuilt often
+        FAST,
+        /// SAH builder with 16 bins per axis
+        MEDIUM,
+        /// SAH builder with 32 bins per axis
+        HIGH
+    };
+
+    /// Settings for building the bounding volume hierarchy of a mesh
+    struct BVHBuildSettings {
+        /// builder used to create the hierarchy
+        BVHBuilderType builder = BVHBuilderType::SAH;
+        /// number of bins per axis the SAH builder evaluates as split candidates
+        unsigned sahBinCount = 16;
+        /// estimated cost of traversing one node (relative to intersectionCost)
+        float traversalCost = 1.0f;
+        /// estimated cost of intersecting one triangle
+        float intersectionCost = 1.0f;
+        /// upper bound of triangles in a leaf, larger nodes are split even if the SAH prefers a leaf
+        unsigned maxTrianglesPerLeaf = 16;
+        /// maximum depth of the hierarchy, nodes at this depth become leaves regardless of their size
+        unsigned maxDepth = 64;
+        /// number of threads used to build the hierarchy, 0 uses all available threads
+        unsigned buildThreads = 0;
+        /// length of the Morton codes the LBVH builder sorts by, either 30 or 63 bits
+        unsigned mortonCodeBits = 30;
+        /// number of triangles at which the LBVH builder stops splitting
+        unsigned lbvhTrianglesPerLeaf = 4;
+        /// additional triangle references the SBVH builder may create, relative to the triangle count
+        float sbvhDuplicateBudget = 0.3f;
+        /// overlap of the best object split children, relative to the root surface area, above which the SBVH
+        /// builder evaluates spatial splits
+        float sbvhOverlapThreshold = 1e-5f;
+        /// growth of the SAH cost of a refit hierarchy, relative to its last full build, at which it is rebuilt
+        float refitRebuildThreshold = 1.5f;
+        /// node layout the binary hierarchy is collapsed into for traversal
+        BVHLayout layout = BVHLayout::BVH4;
+        /// load built hierarchies from and store them in the on-disk cache
+        bool useCache = true;
+        /// directory of the hierarchy cache, empty stores it in a .bvhcache directory next to each mesh
+        std::string cacheDirectory{};
+
+        /**
+         * Apply a build quality preset, selecting builder and bin count
+         * @param quality preset to apply
+         */
+        void applyQuality(BVHBuildQuality quality);
+
+        /**
+         * Parse a builder name as given on the command line
+         * @param name name of the builder (midpoint, sah, lbvh, sbvh)
+         * @param type parsed builder type
+         * @return true if the name was valid
+         */
+        static bool parseBuilderType(const std::string &name, BVHBuilderType &type);
+
+        /// Get the human-readable name of a builder type
+        static std::string builderName(BVHBuilderType type);
+
+        /**
+         * Parse a build quality as given on the command line
+         * @param name name of the quality preset (fast, medium, high)
+         * @param quality parsed quality preset
+         * @return true if the name was valid
+         */
+        static bool parseQuality(const std::string &name, BVHBuildQuality &quality);
+
+        /**
+         * Parse a node layout as given on the command line
+         * @param name name of the layout (binary, bvh4, bvh8, bvh4q8, bvh4q16, bvh8q8, bvh8q16)
+         * @param layout parsed layout
+         * @return true if the name was valid
+         */
+        static bool parseLayout(const std::string &name, BVHLayout &layout);
+
+        /// Get the human-readable name of a node layout
+        static std::string layoutName(BVHLayout layout);
+    };
+
+    /// Base class of all bounding volume hierarchy builders
+    class BVHBuilder {
+    protected:
+        /// minimum number of triangles in a node before its subtrees are built in parallel tasks
+        static constexpr unsigned PARALLEL_SUBTREE_THRESHOLD = 1024;
+
+        BVHBuildSettings settings;
+
+        /// Get the number of threads to build with, resolving 0 to all available threads
+        [[nodiscard]] unsigned buildThreadCount() const;
+
+        /// Calculate the bounding box of the given triangles of a mesh
+        [[nodiscard]] static BoundingBox calculateBoundingBoxForTriangles(const Mesh &mesh,
+                                                                          const std::vector<unsigned> &triangles);
+
+        /**
+         * Renumber the leaf ranges so the leaves follow each other in depth first order, for builders whose leaves are
+         * appended to the triangle order by parallel tasks. The result does not depend on the order they were appended.
+         * @param root root of the built tree
+         * @param triangleOrder triangle order the leaves currently reference, replaced by the depth first order
+         */
+        static void orderLeavesDepthFirst(NestedBoundingBox *root, std::vector<unsigned> &triangleOrder);
+
+    public:
+        explicit BVHBuilder(const BVHBuildSettings &settings) : settings(settings) {
+        }
+
+        virtual ~BVHBuilder() = default;
+
+        /**
+         * Build the nested bounding box hierarchy of a mesh. Leaves do not copy their triangles, they reference a range
+         * of triangleOrder, which lists the mesh triangle index of every triangle in leaf order. A triangle is listed
+         * more than once if the builder duplicated it.
+         * @param mesh mesh to build the hierarchy for
+         * @param triangleOrder filled with the triangle indices of the mesh in leaf order
+         * @return root of the hierarchy, owned by the caller
+         */
+        virtual NestedBoundingBox *build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) = 0;
+
+        /// Get the identifier of the builder
+        virtual std::string identifier() = 0;
+
+        /**
+         * Create the builder selected in the settings
+         * @param settings build settings
+         * @return new builder instance, owned by the caller
+         */
+        static BVHBuilder *create(const BVHBuildSettings &settings);
+    };
+}
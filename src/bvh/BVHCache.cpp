@@ -0,0 +1,200 @@
+#include "BVHCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace RayTracing {
+    static constexpr uint64_t FNV_OFFSET_BASIS = 1469598103934665603ull;
+    static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    /// Continue a FNV-1a hash with a block of bytes
+    static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    static uint64_t hashValue(uint64_t hash, const T &value) {
+        return hashBytes(hash, &value, sizeof(T));
+    }
+
+    /// Fixed size header in front of the node and triangle order arrays of a cache file
+    struct BVHCacheHeader {
+        char magic[8];
+        uint32_t version;
+        /// size of the stored nodes, a cache written by a build with a different layout is rejected
+        uint32_t nodeSize;
+        uint32_t depth;
+        uint64_t key;
+        uint64_t nodeCount;
+        uint64_t triangleCount;
+    };
+
+    static constexpr char CACHE_MAGIC[8] = {'R', 'T', 'B', 'V', 'H', 'C', 'C', 'H'};
+
+    /**
+     * Check that the loaded nodes form a hierarchy that can be traversed safely: children are stored after their
+     * parent inside of the node array, leaves reference stored triangles and the depth fits the traversal stacks
+     * @param nodes loaded nodes
+     * @param triangleOrder loaded triangle order, referenced by the leaves
+     * @param fileTriangleCount number of triangles in the mesh file
+     * @param depth set to the depth of the hierarchy
+     * @return true if the hierarchy is valid
+     */
+    static bool validHierarchy(const std::vector<LinearBVHNode> &nodes, const std::vector<unsigned> &triangleOrder,
+                               unsigned fileTriangleCount, unsigned &depth) {
+        for (unsigned triangle: triangleOrder) {
+            if (triangle >= fileTriangleCount) {
+                return false;
+            }
+        }
+        if (nodes.empty() != triangleOrder.empty()) {
+            return false;
+        }
+        // children are stored after their parent, so the depth of every node is known before its children are seen
+        std::vector<unsigned> nodeDepth(nodes.size(), 1);
+        depth = nodes.empty() ? 0 : 1;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const LinearBVHNode &node = nodes[i];
+            if (node.isLeaf()) {
+                if ((uint64_t) node.trianglesOffset + node.triangleCount > triangleOrder.size()) {
+                    return false;
+                }
+                continue;
+            }
+            if (i + 1 >= nodes.size() || node.secondChildOffset <= i + 1 || node.secondChildOffset >= nodes.size()) {
+                return false;
+            }
+            if (nodeDepth[i] + 1 > LINEAR_BVH_MAX_DEPTH) {
+                return false;
+            }
+            nodeDepth[i + 1] = std::max(nodeDepth[i + 1], nodeDepth[i] + 1);
+            nodeDepth[node.secondChildOffset] = std::max(nodeDepth[node.secondChildOffset], nodeDepth[i] + 1);
+            depth = std::max(depth, nodeDepth[i] + 1);
+        }
+        return true;
+    }
+
+    uint64_t BVHCache::cacheKey(uint64_t meshHash, const BVHBuildSettings &settings) {
+        uint64_t key = hashValue(FNV_OFFSET_BASIS, FORMAT_VERSION);
+        key = hashValue(key, meshHash);
+        key = hashValue(key, settings.builder);
+        key = hashValue(key, settings.sahBinCount);
+        key = hashValue(key, settings.traversalCost);
+        key = hashValue(key, settings.intersectionCost);
+        key = hashValue(key, settings.maxTrianglesPerLeaf);
+        key = hashValue(key, settings.maxDepth);
+        key = hashValue(key, settings.mortonCodeBits);
+        key = hashValue(key, settings.lbvhTrianglesPerLeaf);
+        key = hashValue(key, settings.sbvhDuplicateBudget);
+        key = hashValue(key, settings.sbvhOverlapThreshold);
+        // buildThreads is not part of the key, every thread count builds the same hierarchy
+        return key;
+    }
+
+    uint64_t BVHCache::hashFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return 0;
+        }
+        uint64_t hash = FNV_OFFSET_BASIS;
+        char buffer[1 << 16];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+            hash = hashBytes(hash, buffer, file.gcount());
+        }
+        return hash;
+    }
+
+    std::string BVHCache::cachePath(const std::string &meshDirectory, const std::string &meshFileName,
+                                    uint64_t meshHash, const BVHBuildSettings &settings) {
+        std::filesystem::path directory = settings.cacheDirectory.empty()
+                                              ? std::filesystem::path(meshDirectory) / ".bvhcache"
+                                              : std::filesystem::path(settings.cacheDirectory);
+        std::ostringstream name;
+        name << std::filesystem::path(meshFileName).stem().string() << "_" << std::hex << std::setw(16)
+                << std::setfill('0') << cacheKey(meshHash, settings) << ".bvh";
+        return (directory / name.str()).string();
+    }
+
+    LinearBVH *BVHCache::load(const std::string &path, uint64_t meshHash, const BVHBuildSettings &settings,
+                              unsigned fileTriangleCount, std::vector<unsigned> &triangleOrder) {
+        std::error_code error;
+        const uint64_t fileSize = std::filesystem::file_size(path, error);
+        std::ifstream file(path, std::ios::binary);
+        if (error || !file) {
+            return nullptr;
+        }
+        BVHCacheHeader header{};
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+            header.nodeSize != sizeof(LinearBVHNode) || header.key != cacheKey(meshHash, settings)) {
+            return nullptr;
+        }
+        // the counts have to match the file size exactly before anything is allocated for them
+        const uint64_t payloadSize = fileSize - sizeof(header);
+        if (header.nodeCount > UINT32_MAX || header.nodeCount > payloadSize / sizeof(LinearBVHNode) ||
+            header.triangleCount > payloadSize / sizeof(unsigned) ||
+            header.nodeCount * sizeof(LinearBVHNode) + header.triangleCount * sizeof(unsigned) != payloadSize) {
+            return nullptr;
+        }
+
+        std::vector<LinearBVHNode> nodes(header.nodeCount);
+        triangleOrder.resize(header.triangleCount);
+        unsigned depth = 0;
+        if (!file.read(reinterpret_cast<char *>(nodes.data()), nodes.size() * sizeof(LinearBVHNode)) ||
+            !file.read(reinterpret_cast<char *>(triangleOrder.data()), triangleOrder.size() * sizeof(unsigned)) ||
+            !validHierarchy(nodes, triangleOrder, fileTriangleCount, depth)) {
+            triangleOrder.clear();
+            return nullptr;
+        }
+        return new LinearBVH(std::move(nodes), depth);
+    }
+
+    bool BVHCache::store(const std::string &path, uint64_t meshHash, const BVHBuildSettings &settings,
+                         const LinearBVH &bvh, const std::vector<unsigned> &triangleOrder) {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+        // write to a temporary file of this store first, so a concurrent or interrupted run never reads a partial
+        // cache file and concurrent stores of the same key never write to the same file
+        std::ostringstream temporaryName;
+        temporaryName << path << "." << std::hex << std::random_device{}() << std::random_device{}() << ".tmp";
+        std::string temporaryPath = temporaryName.str();
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+            BVHCacheHeader header{};
+            std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+            header.version = FORMAT_VERSION;
+            header.nodeSize = sizeof(LinearBVHNode);
+            header.depth = bvh.getDepth();
+            header.key = cacheKey(meshHash, settings);
+            header.nodeCount = bvh.nodes.size();
+            header.triangleCount = triangleOrder.size();
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(bvh.nodes.data()), bvh.nodes.size() * sizeof(LinearBVHNode));
+            file.write(reinterpret_cast<const char *>(triangleOrder.data()), triangleOrder.size() * sizeof(unsigned));
+            if (!file) {
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+}
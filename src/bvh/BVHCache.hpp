@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BVHBuilder.hpp"
+#include "LinearBVH.hpp"
+
+namespace RayTracing {
+    /**
+     * Persistent cache of built hierarchies. Every mesh file gets one cache file per combination of build settings,
+     * named by a key combining the content hash of the mesh file, the settings that influence the hierarchy and the
+     * format version. The cache file stores the linear nodes together with the triangle order of the leaves.
+     */
+    class BVHCache {
+    private:
+        /// increased whenever the layout of the cache file or of LinearBVHNode changes, or a builder changes its output
+        static constexpr uint32_t FORMAT_VERSION = 3;
+
+        /// Combine the mesh hash with the build settings that change the resulting hierarchy
+        static uint64_t cacheKey(uint64_t meshHash, const BVHBuildSettings &settings);
+
+    public:
+        /**
+         * Calculate the 64 bit FNV-1a hash of the content of a file
+         * @param path path of the file
+         * @return content hash, 0 if the file can not be read
+         */
+        static uint64_t hashFile(const std::string &path);
+
+        /**
+         * Get the path of the cache file of a mesh
+         * @param meshDirectory directory of the mesh file, used if settings.cacheDirectory is empty
+         * @param meshFileName file name of the mesh, used as readable prefix of the cache file
+         * @param meshHash content hash of the mesh file
+         * @param settings settings the hierarchy is built with
+         * @return path of the cache file
+         */
+        static std::string cachePath(const std::string &meshDirectory, const std::string &meshFileName,
+                                     uint64_t meshHash, const BVHBuildSettings &settings);
+
+        /**
+         * Load a hierarchy from the cache
+         * @param path path of the cache file
+         * @param meshHash content hash of the mesh file
+         * @param settings settings the hierarchy has to be built with
+         * @param fileTriangleCount number of triangles in the mesh file, the triangle order is checked against it
+         * @param triangleOrder filled with the triangle indices of the mesh file in leaf order
+         * @return loaded hierarchy owned by the caller, nullptr if there is no valid cache file
+         */
+        static LinearBVH *load(const std::string &path, uint64_t meshHash, const BVHBuildSettings &settings,
+                               unsigned fileTriangleCount, std::vector<unsigned> &triangleOrder);
+
+        /**
+         * Store a hierarchy in the cache, the cache directory is created if needed
+         * @param path path of the cache file
+         * @param meshHash content hash of the mesh file
+         * @param settings settings the hierarchy was built with
+         * @param bvh hierarchy to store
+         * @param triangleOrder triangle indices of the mesh file in leaf order
+         * @return true if the cache file was written
+         */
+        static bool store(const std::string &path, uint64_t meshHash, const BVHBuildSettings &settings,
+                          const LinearBVH &bvh, const std::vector<unsigned> &triangleOrder);
+    };
+}
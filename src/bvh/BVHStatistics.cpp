@@ -0,0 +1,127 @@
+#include "BVHStatistics.hpp"
+
+#include <iomanip>
+
+#include "../Scene.hpp"
+
+namespace RayTracing {
+    MeshBVHStatistics MeshBVHStatistics::collect(const MeshedRayTraceableObject &object, float traversalCost,
+                                                 float intersectionCost) {
+        MeshBVHStatistics statistics;
+        statistics.fileName = object.fileName;
+        statistics.triangleCount = object.mesh->fileTriangleCount;
+        const LinearBVH *bvh = object.linearBVH;
+        if (bvh == nullptr) {
+            return statistics;
+        }
+        statistics.referenceCount = object.mesh->numTriangles;
+        statistics.nodeCount = bvh->nodes.size();
+        statistics.depth = bvh->getDepth();
+        for (const auto &node: bvh->nodes) {
+            if (!node.isLeaf()) {
+                continue;
+            }
+            statistics.leafCount++;
+            if (statistics.leafSizeHistogram.size() <= node.triangleCount) {
+                statistics.leafSizeHistogram.resize(node.triangleCount + 1, 0);
+            }
+            statistics.leafSizeHistogram[node.triangleCount]++;
+        }
+        statistics.sahCost = bvh->sahCost(traversalCost, intersectionCost);
+        statistics.memoryBytes = object.hierarchyMemoryUsage();
+        return statistics;
+    }
+
+    BVHStatistics BVHStatistics::collect(const Scene &scene) {
+        BVHStatistics statistics;
+        for (const auto &object: scene.objects) {
+            statistics.meshes.push_back(MeshBVHStatistics::collect(*object, scene.bvhBuildSettings.traversalCost,
+                                                                   scene.bvhBuildSettings.intersectionCost));
+        }
+        statistics.topLevelNodeCount = scene.topLevelBVH.nodes.size();
+        statistics.topLevelDepth = scene.topLevelBVH.getDepth();
+        return statistics;
+    }
+
+    TraversalCounters BVHStatistics::total() const {
+        TraversalCounters total{topLevel.rays, topLevel.nodeTests, 0};
+        for (const auto &mesh: meshes) {
+            total.nodeTests += mesh.traversal.nodeTests;
+            total.primitiveTests += mesh.traversal.primitiveTests;
+        }
+        return total;
+    }
+
+    void BVHStatistics::print(std::ostream &out) const {
+        for (unsigned i = 0; i < meshes.size(); i++) {
+            const MeshBVHStatistics &mesh = meshes[i];
+            out << "[BVHStats] Mesh " << i << " (" << mesh.fileName << "): " << mesh.triangleCount << " triangles, " <<
+                    mesh.referenceCount << " references (" << std::fixed << std::setprecision(1) <<
+                    mesh.duplicateRatio() * 100 << "% duplicates), " << mesh.nodeCount << " nodes, " << mesh.leafCount
+                    << " leaves, depth " << mesh.depth << ", SAH cost " << std::setprecision(2) << mesh.sahCost << ", "
+                    << mesh.memoryBytes / 1024 << " KiB" << std::endl;
+            out << "[BVHStats]   triangles per leaf:";
+            for (unsigned size = 1; size < mesh.leafSizeHistogram.size(); size++) {
+                if (mesh.leafSizeHistogram[size] > 0) {
+                    out << " " << size << ":" << mesh.leafSizeHistogram[size];
+                }
+            }
+            out << std::endl;
+            if (mesh.traversal.rays > 0) {
+                out << "[BVHStats]   " << mesh.traversal.rays << " rays, " << mesh.traversal.nodeTestsPerRay() <<
+                        " node tests and " << mesh.traversal.primitiveTestsPerRay() << " triangle tests per ray" <<
+                        std::endl;
+            }
+        }
+        out << "[BVHStats] Top level: " << topLevelNodeCount << " nodes, depth " << topLevelDepth << std::endl;
+        if (topLevel.rays > 0) {
+            TraversalCounters all = total();
+            out << "[BVHStats] Sampled " << topLevel.rays << " rays: " << std::setprecision(2) <<
+                    topLevel.nodeTestsPerRay() << " top level node tests, " << all.nodeTestsPerRay() <<
+                    " node tests and " << all.primitiveTestsPerRay() << " triangle tests per ray in total" <<
+                    std::endl;
+        }
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+    /// Convert traversal counters to json including the per ray averages
+    static nlohmann::json traversalToJson(const TraversalCounters &counters) {
+        return {
+            {"rays", counters.rays},
+            {"nodeTests", counters.nodeTests},
+            {"primitiveTests", counters.primitiveTests},
+            {"nodeTestsPerRay", counters.nodeTestsPerRay()},
+            {"primitiveTestsPerRay", counters.primitiveTestsPerRay()}
+        };
+    }
+
+    nlohmann::json BVHStatistics::toJson() const {
+        nlohmann::json meshesJson = nlohmann::json::array();
+        for (const auto &mesh: meshes) {
+            meshesJson.push_back({
+                {"fileName", mesh.fileName},
+                {"triangles", mesh.triangleCount},
+                {"references", mesh.referenceCount},
+                {"duplicateRatio", mesh.duplicateRatio()},
+                {"nodes", mesh.nodeCount},
+                {"leaves", mesh.leafCount},
+                {"depth", mesh.depth},
+                {"leafSizeHistogram", mesh.leafSizeHistogram},
+                {"sahCost", mesh.sahCost},
+                {"memoryBytes", mesh.memoryBytes},
+                {"traversal", traversalToJson(mesh.traversal)}
+            });
+        }
+        return {
+            {"meshes", meshesJson},
+            {
+                "topLevel", {
+                    {"nodes", topLevelNodeCount},
+                    {"depth", topLevelDepth},
+                    {"traversal", traversalToJson(topLevel)}
+                }
+            },
+            {"total", traversalToJson(total())}
+        };
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace RayTracing {
+    struct Scene;
+    class MeshedRayTraceableObject;
+
+    /// Number of tests done while traversing a hierarchy, incremented by the intersect functions if given
+    struct TraversalCounters {
+        /// number of ray queries that traversed the hierarchy
+        uint64_t rays = 0;
+        /// visited nodes, a wide node counts once for all of its children
+        uint64_t nodeTests = 0;
+        /// intersected triangles, or objects for the top level hierarchy
+        uint64_t primitiveTests = 0;
+
+        TraversalCounters &operator+=(const TraversalCounters &other) {
+            rays += other.rays;
+            nodeTests += other.nodeTests;
+            primitiveTests += other.primitiveTests;
+            return *this;
+        }
+
+        /// Get the average node tests per ray query, 0 if no ray was counted
+        [[nodiscard]] double nodeTestsPerRay() const { return rays == 0 ? 0 : (double) nodeTests / (double) rays; }
+
+        /// Get the average primitive tests per ray query, 0 if no ray was counted
+        [[nodiscard]] double primitiveTestsPerRay() const {
+            return rays == 0 ? 0 : (double) primitiveTests / (double) rays;
+        }
+    };
+
+    /// Structure and quality of the hierarchy of a single mesh
+    struct MeshBVHStatistics {
+        std::string fileName;
+        unsigned triangleCount = 0;
+        /// triangle references in the leaves, larger than triangleCount if the builder duplicated triangles
+        unsigned referenceCount = 0;
+        unsigned nodeCount = 0;
+        unsigned leafCount = 0;
+        unsigned depth = 0;
+        /// number of leaves by the number of triangles they contain
+        std::vector<unsigned> leafSizeHistogram;
+        float sahCost = 0;
+        /// memory of the binary nodes, the nodes of the traversed layout and the triangle blocks in bytes
+        size_t memoryBytes = 0;
+        /// tests done in this hierarchy, rays counts the queries that reached the mesh
+        TraversalCounters traversal;
+
+        /// Get the references added by duplicating triangles, relative to the triangle count
+        [[nodiscard]] float duplicateRatio() const {
+            return triangleCount == 0 ? 0 : (float) referenceCount / (float) triangleCount - 1.0f;
+        }
+
+        /**
+         * Collect the structure statistics of the hierarchy of a mesh
+         * @param object mesh object with built hierarchy
+         * @param traversalCost cost of traversing one node, used for the SAH cost
+         * @param intersectionCost cost of intersecting one triangle, used for the SAH cost
+         * @return statistics without traversal counters
+         */
+        static MeshBVHStatistics collect(const MeshedRayTraceableObject &object, float traversalCost,
+                                         float intersectionCost);
+    };
+
+    /// Structure and quality of all hierarchies of a scene, optionally with traversal counters sampled from a render
+    struct BVHStatistics {
+        std::vector<MeshBVHStatistics> meshes;
+        unsigned topLevelNodeCount = 0;
+        unsigned topLevelDepth = 0;
+        /// tests done in the top level hierarchy, rays counts all sampled ray queries
+        TraversalCounters topLevel;
+
+        /**
+         * Collect the structure statistics of the hierarchies of a prepared scene
+         * @param scene prepared scene
+         * @return statistics with one entry per mesh object, in the order of the scene objects
+         */
+        static BVHStatistics collect(const Scene &scene);
+
+        /// Get the node and triangle tests of all meshes and the top level hierarchy combined
+        [[nodiscard]] TraversalCounters total() const;
+
+        /// Print a human-readable report
+        void print(std::ostream &out) const;
+
+        /// Convert the statistics to json, one object per mesh and the scene totals
+        [[nodiscard]] nlohmann::json toJson() const;
+    };
+}
@@ -0,0 +1,151 @@
+#include "LBVHBuilder.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    LBVHBuilder::LBVHBuilder(const BVHBuildSettings &settings) : BVHBuilder(settings) {
+        if (settings.mortonCodeBits != 30 && settings.mortonCodeBits != 63) {
+            throw std::runtime_error("Morton codes have to be 30 or 63 bits, got " +
+                                     std::to_string(settings.mortonCodeBits));
+        }
+    }
+
+    NestedBoundingBox *LBVHBuilder::build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) {
+        this->mesh = &mesh;
+        const int threads = (int) buildThreadCount();
+        triangles.resize(mesh.numTriangles);
+        triangleBounds.resize(mesh.numTriangles);
+
+        BoundingBox centroidBounds = BoundingBox::empty();
+        for (unsigned triangle = 0; triangle < mesh.numTriangles; triangle++) {
+            BoundingBox bounds = BoundingBox::empty();
+            for (int i = 0; i < 3; i++) {
+                bounds.grow(mesh.vertices[mesh.indices[triangle * 3 + i]]);
+            }
+            triangleBounds[triangle] = bounds;
+            centroidBounds.grow(bounds.center());
+        }
+
+        // quantize the centroids to a grid with 2^bitsPerAxis cells per axis inside the centroid bounds
+        const unsigned bitsPerAxis = settings.mortonCodeBits / 3;
+        const float cells = (float) ((1u << bitsPerAxis) - 1);
+        const Vec3 extent = centroidBounds.size();
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (unsigned triangle = 0; triangle < mesh.numTriangles; triangle++) {
+            Vec3 centroid = triangleBounds[triangle].center();
+            uint64_t quantized[3];
+            for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                float relative = extent[axis] > 0 ? (centroid[axis] - centroidBounds.minPos[axis]) / extent[axis] : 0;
+                quantized[axis] = (uint64_t) std::clamp(relative * cells, 0.0f, cells);
+            }
+            triangles[triangle] = {
+                expandBits(quantized[Vec3::X_AXIS]) << 2 | expandBits(quantized[Vec3::Y_AXIS]) << 1 |
+                expandBits(quantized[Vec3::Z_AXIS]),
+                triangle
+            };
+        }
+        radixSort();
+
+        NestedBoundingBox *root = nullptr;
+#pragma omp parallel num_threads(threads) default(shared)
+#pragma omp single
+        root = buildRecursive(0, triangles.size(), 1);
+
+        // the leaves split the sorted triangles into consecutive ranges in depth first order
+        triangleOrder.resize(triangles.size());
+        for (unsigned i = 0; i < triangles.size(); i++) {
+            triangleOrder[i] = triangles[i].triangle;
+        }
+
+        triangles.clear();
+        triangleBounds.clear();
+        this->mesh = nullptr;
+        return root;
+    }
+
+    uint64_t LBVHBuilder::expandBits(uint64_t value) {
+        value &= 0x1fffff;
+        value = (value | value << 32) & 0x1f00000000ffff;
+        value = (value | value << 16) & 0x1f0000ff0000ff;
+        value = (value | value << 8) & 0x100f00f00f00f00f;
+        value = (value | value << 4) & 0x10c30c30c30c30c3;
+        value = (value | value << 2) & 0x1249249249249249;
+        return value;
+    }
+
+    void LBVHBuilder::radixSort() {
+        constexpr unsigned digitBits = 8;
+        constexpr unsigned buckets = 1u << digitBits;
+        std::vector<MortonTriangle> sorted(triangles.size());
+        for (unsigned shift = 0; shift < settings.mortonCodeBits; shift += digitBits) {
+            unsigned offsets[buckets] = {};
+            for (const auto &triangle: triangles) {
+                offsets[(triangle.code >> shift) & (buckets - 1)]++;
+            }
+            unsigned offset = 0;
+            for (auto &bucketOffset: offsets) {
+                unsigned count = bucketOffset;
+                bucketOffset = offset;
+                offset += count;
+            }
+            for (const auto &triangle: triangles) {
+                sorted[offsets[(triangle.code >> shift) & (buckets - 1)]++] = triangle;
+            }
+            triangles.swap(sorted);
+        }
+    }
+
+    NestedBoundingBox *LBVHBuilder::buildRecursive(unsigned begin, unsigned end, unsigned depth) {
+        unsigned count = end - begin;
+        if (count <= settings.lbvhTrianglesPerLeaf || depth >= settings.maxDepth) {
+            return createLeaf(begin, end);
+        }
+
+        unsigned mid;
+        Vec3::Direction splitAxis;
+        uint64_t differingBits = triangles[begin].code ^ triangles[end - 1].code;
+        if (differingBits == 0) {
+            // all centroids fall into the same grid cell, split by count
+            mid = begin + count / 2;
+            splitAxis = Vec3::X_AXIS;
+        } else {
+            // codes are sorted and share all bits above the highest differing one, the split is the first code with
+            // that bit set
+            unsigned bit = 63 - std::countl_zero(differingBits);
+            mid = std::partition_point(triangles.begin() + begin, triangles.begin() + end,
+                                       [bit](const MortonTriangle &t) {
+                                           return ((t.code >> bit) & 1) == 0;
+                                       }) - triangles.begin();
+            // bits are interleaved as x, y, z from the most significant bit of each triple
+            splitAxis = (Vec3::Direction) (2 - bit % 3);
+        }
+
+        NestedBoundingBox *left;
+        NestedBoundingBox *right;
+        if (count >= PARALLEL_SUBTREE_THRESHOLD) {
+#pragma omp task default(shared)
+            left = buildRecursive(begin, mid, depth + 1);
+            right = buildRecursive(mid, end, depth + 1);
+#pragma omp taskwait
+        } else {
+            left = buildRecursive(begin, mid, depth + 1);
+            right = buildRecursive(mid, end, depth + 1);
+        }
+
+        BoundingBox bounds = *left;
+        bounds.grow(*right);
+        return new NestedBoundingBox{bounds, 0, 0, left, right, right->minPos[splitAxis], splitAxis};
+    }
+
+    NestedBoundingBox *LBVHBuilder::createLeaf(unsigned begin, unsigned end) const {
+        BoundingBox bounds = BoundingBox::empty();
+        for (unsigned i = begin; i < end; i++) {
+            bounds.grow(triangleBounds[triangles[i].triangle]);
+        }
+        return new NestedBoundingBox{bounds, begin, end - begin, nullptr, nullptr, 0, Vec3::X_AXIS};
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+#include "BVHBuilder.hpp"
+
+namespace RayTracing {
+    /**
+     * Linear bounding volume hierarchy (LBVH) builder for fast rebuilds.
+     * Triangle centroids are quantized inside the centroid bounds, encoded as 30 or 63 bit Morton codes and radix
+     * sorted. The hierarchy is then emitted by splitting every range at the highest bit in which its first and last
+     * code differ. Building is much faster than with the SAH builder, the resulting hierarchy is of lower quality.
+     */
+    class LBVHBuilder : public BVHBuilder {
+    private:
+        /// Triangle reference sorted by its Morton code
+        struct MortonTriangle {
+            uint64_t code;
+            unsigned triangle;
+        };
+
+        const Mesh *mesh = nullptr;
+        std::vector<MortonTriangle> triangles;
+        /// bounds of every triangle, indexed by the triangle index of the mesh
+        std::vector<BoundingBox> triangleBounds;
+
+        /// Spread the lower 21 bits of value so that two zero bits are between every bit
+        [[nodiscard]] static uint64_t expandBits(uint64_t value);
+
+        /// Stable least significant digit radix sort of triangles by their Morton code
+        void radixSort();
+
+        /// Recursively build the node for the sorted triangles[begin, end)
+        NestedBoundingBox *buildRecursive(unsigned begin, unsigned end, unsigned depth);
+
+        /// Create a leaf referencing the sorted triangles[begin, end), which is the same range in the triangle order
+        NestedBoundingBox *createLeaf(unsigned begin, unsigned end) const;
+
+    public:
+        explicit LBVHBuilder(const BVHBuildSettings &settings);
+
+        NestedBoundingBox *build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) override;
+
+        std::string identifier() override { return "LBVHBuilder"; }
+    };
+}
@@ -0,0 +1,255 @@
+#include "LinearBVH.hpp"
+
+#include <bit>
+#include <stdexcept>
+
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    LinearBVH::LinearBVH(const NestedBoundingBox *root) {
+        // an empty mesh gets no nodes, a leaf without triangles could not be told apart from an inner node
+        if (root == nullptr || (root->left == nullptr && root->triangleCount == 0)) {
+            return;
+        }
+        nodes.reserve(root->totalNodeCount());
+        flattenRecursive(root, 1);
+    }
+
+    unsigned LinearBVH::flattenRecursive(const NestedBoundingBox *box, unsigned currentDepth) {
+        if (currentDepth > LINEAR_BVH_MAX_DEPTH) {
+            throw std::runtime_error("Bounding volume hierarchy exceeds the maximum depth of " +
+                                     std::to_string(LINEAR_BVH_MAX_DEPTH));
+        }
+        depth = std::max(depth, currentDepth);
+
+        unsigned nodeIndex = nodes.size();
+        nodes.emplace_back();
+        nodes[nodeIndex].bounds = *box;
+
+        if (box->left == nullptr || box->right == nullptr) {
+            nodes[nodeIndex].trianglesOffset = box->trianglesOffset;
+            nodes[nodeIndex].triangleCount = box->triangleCount;
+            nodes[nodeIndex].splitAxis = 0;
+            return nodeIndex;
+        }
+
+        nodes[nodeIndex].triangleCount = 0;
+        nodes[nodeIndex].splitAxis = box->splitAxis;
+        flattenRecursive(box->left, currentDepth + 1);
+        unsigned secondChild = flattenRecursive(box->right, currentDepth + 1);
+        nodes[nodeIndex].secondChildOffset = secondChild;
+        return nodeIndex;
+    }
+
+    HitInfo LinearBVH::intersect(const LocalRay &ray, const Mesh &mesh, TraversalCounters *counters) const {
+        HitInfo closest{.hit = false, .distance = INFINITY};
+        if (mesh.numTriangles == 0) {
+            // empty hierarchy without nodes
+            return closest;
+        }
+
+        unsigned stack[LINEAR_BVH_MAX_DEPTH];
+        unsigned stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            unsigned nodeIndex = stack[--stackSize];
+            const LinearBVHNode &node = nodes[nodeIndex];
+            if (counters != nullptr) {
+                counters->nodeTests++;
+            }
+            // boxes entered beyond the closest hit so far can not contain a closer triangle
+            if (!ray.intersectsBoundingBox(node.bounds, closest.distance)) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                if (counters != nullptr) {
+                    counters->primitiveTests += node.triangleCount;
+                }
+                intersectTriangles(ray, mesh, node.trianglesOffset, node.triangleCount, closest);
+            } else if (ray.direction[node.splitAxis] < 0) {
+                // visit the child on the side the ray comes from first, its hits prune the other child
+                stack[stackSize++] = nodeIndex + 1;
+                stack[stackSize++] = node.secondChildOffset;
+            } else {
+                stack[stackSize++] = node.secondChildOffset;
+                stack[stackSize++] = nodeIndex + 1;
+            }
+        }
+        return closest;
+    }
+
+    bool LinearBVH::occluded(const LocalRay &ray, const Mesh &mesh, float maxDistance,
+                             TraversalCounters *counters) const {
+        if (mesh.numTriangles == 0) {
+            return false;
+        }
+
+        // the children are visited in stored order, any hit ends the traversal so sorting them would not pay off
+        unsigned stack[LINEAR_BVH_MAX_DEPTH];
+        unsigned stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            unsigned nodeIndex = stack[--stackSize];
+            const LinearBVHNode &node = nodes[nodeIndex];
+            if (counters != nullptr) {
+                counters->nodeTests++;
+            }
+            if (!ray.intersectsBoundingBox(node.bounds, maxDistance)) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                if (counters != nullptr) {
+                    counters->primitiveTests += node.triangleCount;
+                }
+                if (occludedTriangles(ray, mesh, node.trianglesOffset, node.triangleCount, maxDistance)) {
+                    return true;
+                }
+            } else {
+                stack[stackSize++] = node.secondChildOffset;
+                stack[stackSize++] = nodeIndex + 1;
+            }
+        }
+        return false;
+    }
+
+    void LinearBVH::intersectPacket(RayPacket &packet, uint64_t mask, const Mesh &mesh) const {
+        if (mesh.numTriangles == 0 || mask == 0) {
+            return;
+        }
+
+        struct StackEntry {
+            uint32_t node;
+            uint64_t mask;
+        };
+        StackEntry stack[LINEAR_BVH_MAX_DEPTH + 1];
+        unsigned stackSize = 0;
+        stack[stackSize++] = {0, mask};
+        while (stackSize > 0) {
+            StackEntry entry = stack[--stackSize];
+            const LinearBVHNode &node = nodes[entry.node];
+            uint64_t hits = packet.intersectBox(node.bounds, entry.mask);
+            if (hits == 0) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                mesh.triangleBlocks.intersectPacket(packet, hits, node.trianglesOffset, node.triangleCount);
+            } else if (packet.direction[node.splitAxis][std::countr_zero(hits)] < 0) {
+                // visit the child on the side the first ray comes from first
+                stack[stackSize++] = {entry.node + 1, hits};
+                stack[stackSize++] = {node.secondChildOffset, hits};
+            } else {
+                stack[stackSize++] = {node.secondChildOffset, hits};
+                stack[stackSize++] = {entry.node + 1, hits};
+            }
+        }
+    }
+
+    void LinearBVH::intersectTriangles(const LocalRay &ray, const Mesh &mesh, unsigned first, unsigned count,
+                                       HitInfo &closest) {
+        if (!mesh.triangleBlocks.empty()) {
+            mesh.triangleBlocks.intersect(ray, mesh, first, count, closest);
+            return;
+        }
+        for (unsigned i = first; i < first + count; i++) {
+            const int *startIndex = &mesh.indices[i * 3];
+            Vec3 triangle[3] = {
+                mesh.vertices[startIndex[0]],
+                mesh.vertices[startIndex[1]],
+                mesh.vertices[startIndex[2]]
+            };
+            auto intersection = ray.intersectTriangle(triangle, mesh.normals[i]);
+            if (intersection.hit && intersection.distance < closest.distance) {
+                closest = intersection;
+            }
+        }
+    }
+
+    bool LinearBVH::occludedTriangles(const LocalRay &ray, const Mesh &mesh, unsigned first, unsigned count,
+                                      float maxDistance) {
+        if (!mesh.triangleBlocks.empty()) {
+            return mesh.triangleBlocks.occluded(ray, first, count, maxDistance);
+        }
+        for (unsigned i = first; i < first + count; i++) {
+            const int *startIndex = &mesh.indices[i * 3];
+            Vec3 triangle[3] = {
+                mesh.vertices[startIndex[0]],
+                mesh.vertices[startIndex[1]],
+                mesh.vertices[startIndex[2]]
+            };
+            auto intersection = ray.intersectTriangle(triangle, mesh.normals[i]);
+            if (intersection.hit && intersection.distance < maxDistance) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned LinearBVH::triangleCount() const {
+        unsigned count = 0;
+        for (const auto &node: nodes) {
+            count += node.isLeaf() ? node.triangleCount : 0;
+        }
+        return count;
+    }
+
+    float LinearBVH::sahCost(float traversalCost, float intersectionCost) const {
+        if (nodes.empty()) {
+            return 0;
+        }
+        if (nodes[0].bounds.surfaceArea() <= 0) {
+            return intersectionCost * (float) triangleCount();
+        }
+        return sahCost(nodes, traversalCost, intersectionCost);
+    }
+
+    float LinearBVH::sahCost(const std::vector<LinearBVHNode> &nodes, float traversalCost, float intersectionCost) {
+        if (nodes.empty()) {
+            return 0;
+        }
+        float rootArea = nodes[0].bounds.surfaceArea();
+        if (rootArea <= 0) {
+            return 0;
+        }
+        float cost = 0;
+        for (const auto &node: nodes) {
+            float relativeArea = node.bounds.surfaceArea() / rootArea;
+            cost += relativeArea * (node.isLeaf() ? intersectionCost * (float) node.triangleCount : traversalCost);
+        }
+        return cost;
+    }
+
+    void LinearBVH::refit(const Mesh &mesh) {
+        if (mesh.numTriangles == 0) {
+            return;
+        }
+        for (auto &node: nodes) {
+            if (!node.isLeaf()) {
+                continue;
+            }
+            node.bounds = BoundingBox::empty();
+            for (unsigned i = node.trianglesOffset * 3; i < (node.trianglesOffset + node.triangleCount) * 3; i++) {
+                node.bounds.grow(mesh.vertices[mesh.indices[i]]);
+            }
+        }
+        refitInnerNodes(nodes);
+    }
+
+    void LinearBVH::refitInnerNodes(std::vector<LinearBVHNode> &nodes) {
+        if (nodes.size() < 2) {
+            // a single node has no children, it is either a leaf or the root of an empty hierarchy
+            return;
+        }
+        // children are always stored after their parent, so walking backwards visits them first
+        for (unsigned i = nodes.size(); i-- > 0;) {
+            LinearBVHNode &node = nodes[i];
+            if (node.isLeaf()) {
+                continue;
+            }
+            node.bounds = nodes[i + 1].bounds;
+            node.bounds.grow(nodes[node.secondChildOffset].bounds);
+        }
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "BVHStatistics.hpp"
+#include "../Ray.hpp"
+#include "../RayPacket.hpp"
+#include "../raytrace_objects/BoundigBox.hpp"
+
+namespace RayTracing {
+    struct Mesh;
+
+    /// maximum depth of a linear bounding volume hierarchy, limited by the fixed size traversal stack
+    constexpr unsigned LINEAR_BVH_MAX_DEPTH = 64;
+
+    /**
+     * Node of a linear bounding volume hierarchy stored in depth first order.
+     * The first child of an inner node directly follows its parent, only the offset of the second child is stored.
+     * Two nodes fit into a single 64 byte cache line.
+     */
+    struct alignas(32) LinearBVHNode {
+        BoundingBox bounds;
+
+        union {
+            /// leaf node: index of the first triangle in the triangle arrays of the mesh, which are in leaf order
+            uint32_t trianglesOffset;
+            /// inner node: index of the second child node
+            uint32_t secondChildOffset;
+        };
+
+        /// number of triangles in a leaf node, 0 for inner nodes
+        uint32_t triangleCount : 30;
+        /// axis along which an inner node was split
+        uint32_t splitAxis : 2;
+
+        [[nodiscard]] bool isLeaf() const {
+            return triangleCount > 0;
+        }
+    };
+
+    static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes to pack two nodes per cache line");
+
+    /**
+     * Pointer free bounding volume hierarchy. The triangle arrays of the mesh are reordered into leaf order when the
+     * hierarchy is built, so every leaf references a contiguous range of them instead of copying its triangles.
+     */
+    class LinearBVH {
+    private:
+        unsigned depth = 0;
+
+        /// Flatten the subtree of box in depth first order, returns the index of the created node
+        unsigned flattenRecursive(const NestedBoundingBox *box, unsigned currentDepth);
+
+    public:
+        std::vector<LinearBVHNode> nodes;
+
+        LinearBVH() = default;
+
+        /**
+         * Flatten a nested bounding box tree into a linear hierarchy, the leaves keep their triangle ranges
+         * @param root root of the nested bounding box tree
+         */
+        explicit LinearBVH(const NestedBoundingBox *root);
+
+        /**
+         * Create a linear hierarchy from already flattened nodes, e.g. loaded from the cache
+         * @param nodes nodes in depth first order
+         * @param depth maximum depth of the hierarchy
+         */
+        LinearBVH(std::vector<LinearBVHNode> nodes, unsigned depth) : depth(depth), nodes(std::move(nodes)) {
+        }
+
+        /**
+         * Find the closest intersection of a ray with the triangles of the mesh. Children are visited near to far along
+         * their split axis and boxes entered beyond the closest hit so far are skipped.
+         * @param ray ray in local object space
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return closest intersection in local object space
+         */
+        [[nodiscard]] HitInfo intersect(const LocalRay &ray, const Mesh &mesh,
+                                        TraversalCounters *counters = nullptr) const;
+
+        /**
+         * Check if a ray hits any triangle of the mesh closer than maxDistance. Traversal stops at the first hit and
+         * no hit point or normal is calculated.
+         * @param ray ray in local object space
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param maxDistance only hits closer than this distance count
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return true if a triangle is hit
+         */
+        [[nodiscard]] bool occluded(const LocalRay &ray, const Mesh &mesh, float maxDistance,
+                                    TraversalCounters *counters = nullptr) const;
+
+        /**
+         * Find the closest intersections of the selected rays of a packet with the triangles of the mesh. All rays
+         * visit a node together and the node is skipped as soon as none of them hits its box.
+         * @param packet rays in local object space, the distance and primitive of rays hitting a closer triangle are
+         * updated
+         * @param mask selected rays
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order and built triangle blocks
+         */
+        void intersectPacket(RayPacket &packet, uint64_t mask, const Mesh &mesh) const;
+
+        /**
+         * Intersect a ray with the triangles of a leaf and keep the closest hit. Uses the triangle blocks of the mesh
+         * if they are built, otherwise the triangles are tested one by one.
+         * @param ray ray in local object space
+         * @param mesh mesh with its triangles in leaf order
+         * @param first index of the first triangle of the leaf
+         * @param count number of triangles in the leaf
+         * @param closest closest hit so far, updated if a closer triangle is hit
+         */
+        static void intersectTriangles(const LocalRay &ray, const Mesh &mesh, unsigned first, unsigned count,
+                                       HitInfo &closest);
+
+        /**
+         * Check if a ray hits any triangle of a leaf closer than maxDistance. Uses the triangle blocks of the mesh if
+         * they are built, otherwise the triangles are tested one by one.
+         * @param ray ray in local object space
+         * @param mesh mesh with its triangles in leaf order
+         * @param first index of the first triangle of the leaf
+         * @param count number of triangles in the leaf
+         * @param maxDistance only hits closer than this distance count
+         * @return true if a triangle is hit
+         */
+        [[nodiscard]] static bool occludedTriangles(const LocalRay &ray, const Mesh &mesh, unsigned first,
+                                                    unsigned count, float maxDistance);
+
+        /// Get the maximum depth of the hierarchy
+        [[nodiscard]] unsigned getDepth() const { return depth; }
+
+        /// Get the number of triangles referenced by the leaves
+        [[nodiscard]] unsigned triangleCount() const;
+
+        /// Get the memory used by the nodes in bytes
+        [[nodiscard]] size_t memoryUsage() const { return nodes.size() * sizeof(LinearBVHNode); }
+
+        /**
+         * Calculate the surface area heuristic cost of the hierarchy, the expected cost of tracing a ray that hits the
+         * root box. Lower values are better, the costs of different builders for the same mesh can be compared.
+         * @param traversalCost cost of traversing one node
+         * @param intersectionCost cost of intersecting one triangle
+         * @return SAH cost of the hierarchy
+         */
+        [[nodiscard]] float sahCost(float traversalCost, float intersectionCost) const;
+
+        /**
+         * Calculate the surface area heuristic cost of any hierarchy stored as linear nodes
+         * @param nodes nodes in depth first order, the root first
+         * @param traversalCost cost of traversing one node
+         * @param intersectionCost cost of intersecting one triangle (or object)
+         * @return SAH cost of the hierarchy
+         */
+        [[nodiscard]] static float sahCost(const std::vector<LinearBVHNode> &nodes, float traversalCost,
+                                           float intersectionCost);
+
+        /**
+         * Update the bounds of all nodes bottom-up after the vertices of the mesh moved.
+         * The structure of the hierarchy is kept, so its quality degrades the further the vertices move.
+         * @param mesh mesh the hierarchy was built for, with updated vertices and its triangles in leaf order
+         */
+        void refit(const Mesh &mesh);
+
+        /**
+         * Update the bounds of all inner nodes from their children, in reverse depth first order
+         * @param nodes nodes in depth first order with updated leaf bounds
+         */
+        static void refitInnerNodes(std::vector<LinearBVHNode> &nodes);
+    };
+}
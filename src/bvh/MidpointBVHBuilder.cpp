@@ -0,0 +1,105 @@
+#include "MidpointBVHBuilder.hpp"
+
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    NestedBoundingBox *MidpointBVHBuilder::build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) {
+        this->mesh = &mesh;
+        this->triangleOrder = &triangleOrder;
+        triangleOrder.clear();
+        std::vector<unsigned> triangles(mesh.numTriangles);
+        for (unsigned triangle = 0; triangle < mesh.numTriangles; triangle++) {
+            triangles[triangle] = triangle;
+        }
+        unsigned maxTriangleCount = mesh.numTriangles;
+        if (maxTriangleCount > 500) {
+            maxTriangleCount /= 2;
+        }
+        if (maxTriangleCount > 4000) {
+            maxTriangleCount /= 2;
+        }
+        NestedBoundingBox *root = nullptr;
+#pragma omp parallel num_threads((int) buildThreadCount()) default(shared)
+#pragma omp single
+        root = buildRecursive(triangles, maxTriangleCount + 1, 1);
+        // leaves were appended by concurrent tasks, renumber them to get the same order for every thread count
+        orderLeavesDepthFirst(root, triangleOrder);
+        this->mesh = nullptr;
+        this->triangleOrder = nullptr;
+        return root;
+    }
+
+    NestedBoundingBox *MidpointBVHBuilder::buildRecursive(const std::vector<unsigned> &triangles,
+                                                          unsigned maxTrianglesPerBox, unsigned depth) {
+        BoundingBox innerBoundingBox = calculateBoundingBoxForTriangles(*mesh, triangles);
+        if (triangles.size() <= maxTrianglesPerBox || depth >= settings.maxDepth) {
+            return createLeaf(triangles, innerBoundingBox);
+        }
+        // get longest axis to split along
+        Vec3::Direction splitAxis = Vec3::X_AXIS;
+        float length = 0;
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            float axisLength = innerBoundingBox.maxPos.getValue(axis) - innerBoundingBox.minPos.getValue(axis);
+            if (axisLength > length) {
+                length = axisLength;
+                splitAxis = axis;
+            }
+        }
+
+        // split triangles along axis center
+        std::vector<unsigned> trianglesLeft = {};
+        std::vector<unsigned> trianglesRight = {};
+        float splitValue = innerBoundingBox.minPos.getValue(splitAxis) + (length / 2.0f);
+        for (unsigned triangle: triangles) {
+            bool left = false;
+            bool right = false;
+            unsigned triangleStartIndex = triangle * 3;
+            for (int i = 0; i < 3; i++) {
+                float axisValue = mesh->vertices[mesh->indices[triangleStartIndex + i]].getValue(splitAxis);
+                if (axisValue <= splitValue) {
+                    left = true;
+                } else {
+                    right = true;
+                }
+            }
+            if (left) {
+                trianglesLeft.push_back(triangle);
+            }
+            if (right) {
+                trianglesRight.push_back(triangle);
+            }
+        }
+
+        /// Check if split was possible and prevent (call)stack overflow
+        if (trianglesLeft.size() == triangles.size() || trianglesRight.size() == triangles.size()) {
+            // unable to split further
+            return createLeaf(triangles, innerBoundingBox);
+        }
+
+        NestedBoundingBox *left;
+        NestedBoundingBox *right;
+        if (triangles.size() >= PARALLEL_SUBTREE_THRESHOLD) {
+            // the left subtree is built in a separate task, both children only read their own triangle lists
+#pragma omp task default(shared)
+            left = buildRecursive(trianglesLeft, maxTrianglesPerBox, depth + 1);
+            right = buildRecursive(trianglesRight, maxTrianglesPerBox, depth + 1);
+#pragma omp taskwait
+        } else {
+            left = buildRecursive(trianglesLeft, maxTrianglesPerBox, depth + 1);
+            right = buildRecursive(trianglesRight, maxTrianglesPerBox, depth + 1);
+        }
+
+        return new NestedBoundingBox{innerBoundingBox, 0, 0, left, right, splitValue, splitAxis};
+    }
+
+    NestedBoundingBox *MidpointBVHBuilder::createLeaf(const std::vector<unsigned> &triangles,
+                                                      const BoundingBox &bounds) {
+        unsigned offset;
+#pragma omp critical(midpointTriangleOrder)
+        {
+            offset = triangleOrder->size();
+            triangleOrder->insert(triangleOrder->end(), triangles.begin(), triangles.end());
+        }
+        return new NestedBoundingBox{bounds, offset, (unsigned) triangles.size(), nullptr, nullptr, 0, Vec3::X_AXIS};
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "BVHBuilder.hpp"
+
+namespace RayTracing {
+    /// Legacy builder splitting at the center of the longest axis, straddling triangles are copied into both children
+    class MidpointBVHBuilder : public BVHBuilder {
+    private:
+        const Mesh *mesh = nullptr;
+        /// triangle order the leaves are appended to while building
+        std::vector<unsigned> *triangleOrder = nullptr;
+
+        /// Recursively build the nested bounding box for the given triangles of the mesh
+        NestedBoundingBox *buildRecursive(const std::vector<unsigned> &triangles,
+                                          unsigned maxTrianglesPerBox,
+                                          unsigned depth);
+
+        /// Create a leaf and append its triangles to the triangle order
+        NestedBoundingBox *createLeaf(const std::vector<unsigned> &triangles, const BoundingBox &bounds);
+
+    public:
+        explicit MidpointBVHBuilder(const BVHBuildSettings &settings) : BVHBuilder(settings) {
+        }
+
+        NestedBoundingBox *build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) override;
+
+        std::string identifier() override { return "MidpointBVHBuilder"; }
+    };
+}
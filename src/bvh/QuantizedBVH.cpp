@@ -0,0 +1,102 @@
+#include "QuantizedBVH.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "WideBVHTraversal.hpp"
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    template<unsigned Width, typename Quantized>
+    QuantizedWideBVH<Width, Quantized>::QuantizedWideBVH(const WideBVH<Width> &wide) {
+        nodes.resize(wide.nodes.size());
+        for (unsigned nodeIndex = 0; nodeIndex < wide.nodes.size(); nodeIndex++) {
+            const WideBVHNode<Width> &source = wide.nodes[nodeIndex];
+            QuantizedWideBVHNode<Width, Quantized> &node = nodes[nodeIndex];
+
+            for (unsigned i = 0; i < Width; i++) {
+                if (source.triangleCount[i] > std::numeric_limits<uint16_t>::max()) {
+                    throw std::runtime_error("Leaf with " + std::to_string(source.triangleCount[i]) +
+                                             " triangles can not be stored in a quantized bounding volume hierarchy");
+                }
+                node.child[i] = source.child[i];
+                node.triangleCount[i] = source.triangleCount[i];
+            }
+
+            for (unsigned axis = 0; axis < 3; axis++) {
+                // the grid spans the union of the used children, unused slots have inverted infinite bounds
+                float low = INFINITY;
+                float high = -INFINITY;
+                for (unsigned i = 0; i < Width; i++) {
+                    if (source.bounds[axis * 2][i] <= source.bounds[axis * 2 + 1][i]) {
+                        low = std::min(low, source.bounds[axis * 2][i]);
+                        high = std::max(high, source.bounds[axis * 2 + 1][i]);
+                    }
+                }
+                if (low > high) {
+                    low = high = 0;
+                }
+
+                // widen the grid by a few ulps of its magnitude, so float rounding while decoding can never move a
+                // decoded plane inside the exact bounds
+                float slack = std::max(std::abs(low), std::abs(high)) * 4 * std::numeric_limits<float>::epsilon();
+                float origin = low - slack;
+                float extent = high + slack - origin;
+                float scale = extent > 0
+                                  ? extent / QUANTIZED_MAX * (1 + 4 * std::numeric_limits<float>::epsilon())
+                                  : 1;
+                node.origin[axis] = origin;
+                node.scale[axis] = scale;
+
+                for (unsigned i = 0; i < Width; i++) {
+                    float childLow = source.bounds[axis * 2][i];
+                    float childHigh = source.bounds[axis * 2 + 1][i];
+                    if (childLow > childHigh) {
+                        // unused slot, decodes to an inverted box that is never hit
+                        node.bounds[axis * 2][i] = (Quantized) QUANTIZED_MAX;
+                        node.bounds[axis * 2 + 1][i] = 0;
+                        continue;
+                    }
+                    float quantizedLow = std::floor((childLow - slack - origin) / scale);
+                    float quantizedHigh = std::ceil((childHigh + slack - origin) / scale);
+                    node.bounds[axis * 2][i] = (Quantized) std::clamp(quantizedLow, 0.0f, QUANTIZED_MAX);
+                    node.bounds[axis * 2 + 1][i] = (Quantized) std::clamp(quantizedHigh, 0.0f, QUANTIZED_MAX);
+                }
+            }
+        }
+    }
+
+    namespace {
+        /// Decode the quantized positions of a plane of all children of a node to floats
+        template<unsigned Width, typename Quantized>
+        struct DecodedPlanes {
+            typename FloatLanes<Width>::Type operator()(const QuantizedWideBVHNode<Width, Quantized> &node,
+                                                        unsigned plane, unsigned axis) const {
+                using Lanes = typename FloatLanes<Width>::Type;
+                float decoded[Width];
+                for (unsigned i = 0; i < Width; i++) {
+                    decoded[i] = (float) node.bounds[plane][i];
+                }
+                return Lanes::broadcast(node.origin[axis]) + Lanes::load(decoded) * Lanes::broadcast(node.scale[axis]);
+            }
+        };
+    }
+
+    template<unsigned Width, typename Quantized>
+    HitInfo QuantizedWideBVH<Width, Quantized>::intersect(const LocalRay &ray, const Mesh &mesh,
+                                                          TraversalCounters *counters) const {
+        return WideBVHTraversal<Width>(ray).intersect(nodes, mesh, DecodedPlanes<Width, Quantized>(), counters);
+    }
+
+    template<unsigned Width, typename Quantized>
+    bool QuantizedWideBVH<Width, Quantized>::occluded(const LocalRay &ray, const Mesh &mesh, float maxDistance,
+                                                      TraversalCounters *counters) const {
+        return WideBVHTraversal<Width>(ray).occluded(nodes, mesh, maxDistance, DecodedPlanes<Width, Quantized>(),
+                                                     counters);
+    }
+
+    template class QuantizedWideBVH<4, uint8_t>;
+    template class QuantizedWideBVH<4, uint16_t>;
+    template class QuantizedWideBVH<8, uint8_t>;
+    template class QuantizedWideBVH<8, uint16_t>;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "WideBVH.hpp"
+
+namespace RayTracing {
+    /**
+     * Compressed node of a wide bounding volume hierarchy.
+     * The child bounds are stored as Quantized integers on a grid spanning the bounds of the node, so a node only
+     * needs the grid origin and step size in full precision. Quantized bounds are rounded outwards and always enclose
+     * the exact child bounds.
+     */
+    template<unsigned Width, typename Quantized>
+    struct QuantizedWideBVHNode {
+        /// lower corner of the quantization grid per axis
+        float origin[3];
+        /// size of one quantization step per axis
+        float scale[3];
+        /// quantized child bounds per plane: min x, max x, min y, max y, min z, max z
+        Quantized bounds[6][Width];
+        /// inner child: index of the child node, leaf child: index of its first triangle
+        uint32_t child[Width];
+        /// number of triangles of a leaf child, 0 for inner children and unused slots
+        uint16_t triangleCount[Width];
+    };
+
+    /**
+     * Wide bounding volume hierarchy with child bounds quantized to 8 or 16 bits relative to their parent node.
+     * It has the same structure as the WideBVH it is compressed from and is traversed the same way, the child bounds
+     * are decoded to floats right before the SIMD box test.
+     */
+    template<unsigned Width, typename Quantized>
+    class QuantizedWideBVH {
+    private:
+        /// largest quantized value, the upper end of the grid
+        static constexpr float QUANTIZED_MAX = (float) std::numeric_limits<Quantized>::max();
+
+    public:
+        std::vector<QuantizedWideBVHNode<Width, Quantized> > nodes;
+
+        /**
+         * Compress a wide hierarchy, node indices and triangle ranges are kept
+         * @param wide uncompressed hierarchy
+         */
+        explicit QuantizedWideBVH(const WideBVH<Width> &wide);
+
+        /**
+         * Find the closest intersection of a ray with the triangles of the mesh
+         * @param ray ray in local object space
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return closest intersection in local object space
+         */
+        [[nodiscard]] HitInfo intersect(const LocalRay &ray, const Mesh &mesh,
+                                        TraversalCounters *counters = nullptr) const;
+
+        /**
+         * Check if a ray hits any triangle of the mesh closer than maxDistance, traversed like WideBVH::occluded
+         * @param ray ray in local object space
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param maxDistance only hits closer than this distance count
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return true if a triangle is hit
+         */
+        [[nodiscard]] bool occluded(const LocalRay &ray, const Mesh &mesh, float maxDistance,
+                                    TraversalCounters *counters = nullptr) const;
+
+        /// Get the memory used by the nodes in bytes
+        [[nodiscard]] size_t memoryUsage() const {
+            return nodes.size() * sizeof(QuantizedWideBVHNode<Width, Quantized>);
+        }
+    };
+}
@@ -0,0 +1,266 @@
+#include "SAHBVHBuilder.hpp"
+
+#include <algorithm>
+
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    /**
+     * Call function for every chunk index, the chunks are distributed over tasks if there is more than one.
+     * The work of a chunk does not depend on the number of threads, which keeps parallel builds deterministic.
+     */
+    template<typename Function>
+    static void forEachChunk(unsigned chunkCount, const Function &function) {
+#pragma omp taskloop grainsize(1) default(shared) if(chunkCount > 1)
+        for (unsigned chunk = 0; chunk < chunkCount; chunk++) {
+            function(chunk);
+        }
+    }
+
+    NestedBoundingBox *SAHBVHBuilder::build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) {
+        this->mesh = &mesh;
+        triangles.resize(mesh.numTriangles);
+        scratch.resize(mesh.numTriangles);
+        const int threads = (int) buildThreadCount();
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (unsigned triangle = 0; triangle < mesh.numTriangles; triangle++) {
+            BoundingBox bounds = BoundingBox::empty();
+            for (int i = 0; i < 3; i++) {
+                bounds.grow(mesh.vertices[mesh.indices[triangle * 3 + i]]);
+            }
+            triangles[triangle] = {bounds, bounds.center(), triangle};
+        }
+
+        NestedBoundingBox *root = nullptr;
+#pragma omp parallel num_threads(threads) default(shared)
+#pragma omp single
+        root = buildRecursive(0, triangles.size(), 1);
+
+        // the partitions leave triangles sorted by leaf in depth first order
+        triangleOrder.resize(triangles.size());
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (unsigned i = 0; i < triangles.size(); i++) {
+            triangleOrder[i] = triangles[i].triangle;
+        }
+
+        triangles.clear();
+        scratch.clear();
+        this->mesh = nullptr;
+        return root;
+    }
+
+    NestedBoundingBox *SAHBVHBuilder::buildRecursive(unsigned begin, unsigned end, unsigned depth) {
+        BoundingBox bounds;
+        BoundingBox centroidBounds;
+        calculateBounds(begin, end, bounds, centroidBounds);
+
+        unsigned count = end - begin;
+        if (count <= 1 || depth >= settings.maxDepth) {
+            return createLeaf(begin, end, bounds);
+        }
+
+        Split split = findBestSplit(begin, end, bounds, centroidBounds);
+        float leafCost = settings.intersectionCost * (float) count;
+        if (split.cost >= leafCost && count <= settings.maxTrianglesPerLeaf) {
+            return createLeaf(begin, end, bounds);
+        }
+
+        unsigned mid;
+        float splitValue;
+        if (split.cost < INFINITY) {
+            mid = partitionTriangles(begin, end, split, centroidBounds);
+            splitValue = centroidBounds.minPos[split.axis] + centroidBounds.size()[split.axis] *
+                         (float) (split.bin + 1) / (float) settings.sahBinCount;
+        } else {
+            // all centroids fall into one bin but the leaf would be too large, split by count instead
+            Vec3 extent = centroidBounds.size();
+            split.axis = extent[Vec3::X_AXIS] > extent[Vec3::Y_AXIS]
+                             ? (extent[Vec3::X_AXIS] > extent[Vec3::Z_AXIS] ? Vec3::X_AXIS : Vec3::Z_AXIS)
+                             : (extent[Vec3::Y_AXIS] > extent[Vec3::Z_AXIS] ? Vec3::Y_AXIS : Vec3::Z_AXIS);
+            mid = begin + count / 2;
+            std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+                             [&](const BuildTriangle &a, const BuildTriangle &b) {
+                                 return a.centroid[split.axis] < b.centroid[split.axis];
+                             });
+            splitValue = triangles[mid].centroid[split.axis];
+        }
+
+        NestedBoundingBox *left;
+        NestedBoundingBox *right;
+        if (count >= PARALLEL_SUBTREE_THRESHOLD) {
+            // both subtrees work on disjoint ranges of triangles, the left one is built in a separate task
+#pragma omp task default(shared)
+            left = buildRecursive(begin, mid, depth + 1);
+            right = buildRecursive(mid, end, depth + 1);
+#pragma omp taskwait
+        } else {
+            left = buildRecursive(begin, mid, depth + 1);
+            right = buildRecursive(mid, end, depth + 1);
+        }
+
+        return new NestedBoundingBox{bounds, 0, 0, left, right, splitValue, split.axis};
+    }
+
+    void SAHBVHBuilder::calculateBounds(unsigned begin, unsigned end, BoundingBox &bounds,
+                                        BoundingBox &centroidBounds) const {
+        const unsigned chunks = chunkCount(begin, end);
+        std::vector chunkBounds(chunks, BoundingBox::empty());
+        std::vector chunkCentroidBounds(chunks, BoundingBox::empty());
+        forEachChunk(chunks, [&](unsigned chunk) {
+            const unsigned chunkEnd = std::min(end, begin + (chunk + 1) * CHUNK_SIZE);
+            for (unsigned i = begin + chunk * CHUNK_SIZE; i < chunkEnd; i++) {
+                chunkBounds[chunk].grow(triangles[i].bounds);
+                chunkCentroidBounds[chunk].grow(triangles[i].centroid);
+            }
+        });
+
+        bounds = BoundingBox::empty();
+        centroidBounds = BoundingBox::empty();
+        for (unsigned chunk = 0; chunk < chunks; chunk++) {
+            bounds.grow(chunkBounds[chunk]);
+            centroidBounds.grow(chunkCentroidBounds[chunk]);
+        }
+    }
+
+    void SAHBVHBuilder::binTriangles(unsigned begin, unsigned end, const BoundingBox &centroidBounds,
+                                     Bins &bins) const {
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            if (centroidBounds.maxPos[axis] <= centroidBounds.minPos[axis]) {
+                continue; // all centroids on one plane, no split possible along this axis
+            }
+            const unsigned offset = axis * settings.sahBinCount;
+            for (unsigned i = begin; i < end; i++) {
+                unsigned bin = offset + binOf(triangles[i].centroid, axis, centroidBounds);
+                bins.bounds[bin].grow(triangles[i].bounds);
+                bins.counts[bin]++;
+            }
+        }
+    }
+
+    unsigned SAHBVHBuilder::partitionTriangles(unsigned begin, unsigned end, const Split &split,
+                                               const BoundingBox &centroidBounds) {
+        auto isLeft = [&](const BuildTriangle &t) {
+            return binOf(t.centroid, split.axis, centroidBounds) <= split.bin;
+        };
+        const unsigned chunks = chunkCount(begin, end);
+        if (chunks == 1) {
+            return std::stable_partition(triangles.begin() + begin, triangles.begin() + end, isLeft) -
+                   triangles.begin();
+        }
+
+        // count the left triangles of every chunk to know where each chunk has to scatter its triangles to
+        std::vector<unsigned> leftCounts(chunks, 0);
+        forEachChunk(chunks, [&](unsigned chunk) {
+            const unsigned chunkEnd = std::min(end, begin + (chunk + 1) * CHUNK_SIZE);
+            for (unsigned i = begin + chunk * CHUNK_SIZE; i < chunkEnd; i++) {
+                if (isLeft(triangles[i])) {
+                    leftCounts[chunk]++;
+                }
+            }
+        });
+
+        std::vector<unsigned> leftOffsets(chunks);
+        std::vector<unsigned> rightOffsets(chunks);
+        unsigned mid = begin;
+        for (unsigned chunk = 0; chunk < chunks; chunk++) {
+            leftOffsets[chunk] = mid;
+            mid += leftCounts[chunk];
+        }
+        unsigned rightOffset = mid;
+        for (unsigned chunk = 0; chunk < chunks; chunk++) {
+            const unsigned chunkEnd = std::min(end, begin + (chunk + 1) * CHUNK_SIZE);
+            rightOffsets[chunk] = rightOffset;
+            rightOffset += chunkEnd - (begin + chunk * CHUNK_SIZE) - leftCounts[chunk];
+        }
+
+        forEachChunk(chunks, [&](unsigned chunk) {
+            const unsigned chunkEnd = std::min(end, begin + (chunk + 1) * CHUNK_SIZE);
+            unsigned left = leftOffsets[chunk];
+            unsigned right = rightOffsets[chunk];
+            for (unsigned i = begin + chunk * CHUNK_SIZE; i < chunkEnd; i++) {
+                if (isLeft(triangles[i])) {
+                    scratch[left++] = triangles[i];
+                } else {
+                    scratch[right++] = triangles[i];
+                }
+            }
+        });
+        forEachChunk(chunks, [&](unsigned chunk) {
+            const unsigned chunkBegin = begin + chunk * CHUNK_SIZE;
+            const unsigned chunkEnd = std::min(end, chunkBegin + CHUNK_SIZE);
+            std::copy(scratch.begin() + chunkBegin, scratch.begin() + chunkEnd, triangles.begin() + chunkBegin);
+        });
+        return mid;
+    }
+
+    NestedBoundingBox *SAHBVHBuilder::createLeaf(unsigned begin, unsigned end, const BoundingBox &bounds) {
+        return new NestedBoundingBox{bounds, begin, end - begin, nullptr, nullptr, 0, Vec3::X_AXIS};
+    }
+
+    unsigned SAHBVHBuilder::binOf(const Vec3 &centroid, Vec3::Direction axis,
+                                  const BoundingBox &centroidBounds) const {
+        float extent = centroidBounds.maxPos[axis] - centroidBounds.minPos[axis];
+        auto bin = (unsigned) ((float) settings.sahBinCount * (centroid[axis] - centroidBounds.minPos[axis]) / extent);
+        return std::min(bin, settings.sahBinCount - 1);
+    }
+
+    SAHBVHBuilder::Split SAHBVHBuilder::findBestSplit(unsigned begin, unsigned end, const BoundingBox &bounds,
+                                                      const BoundingBox &centroidBounds) const {
+        const unsigned binCount = settings.sahBinCount;
+        Bins bins(binCount);
+        const unsigned chunks = chunkCount(begin, end);
+        if (chunks == 1) {
+            binTriangles(begin, end, centroidBounds, bins);
+        } else {
+            std::vector chunkBins(chunks, Bins(binCount));
+            forEachChunk(chunks, [&](unsigned chunk) {
+                binTriangles(begin + chunk * CHUNK_SIZE, std::min(end, begin + (chunk + 1) * CHUNK_SIZE),
+                             centroidBounds, chunkBins[chunk]);
+            });
+            for (const auto &chunkBin: chunkBins) {
+                bins.merge(chunkBin);
+            }
+        }
+
+        std::vector<float> leftArea(binCount);
+        std::vector<unsigned> leftCount(binCount);
+        float parentArea = bounds.surfaceArea();
+
+        Split best;
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            if (centroidBounds.maxPos[axis] <= centroidBounds.minPos[axis]) {
+                continue; // all centroids on one plane, no split possible along this axis
+            }
+            const BoundingBox *binBounds = &bins.bounds[axis * binCount];
+            const unsigned *binCounts = &bins.counts[axis * binCount];
+
+            // sweep from the left to get area and count left of every split plane
+            BoundingBox accumulated = BoundingBox::empty();
+            unsigned accumulatedCount = 0;
+            for (unsigned bin = 0; bin < binCount - 1; bin++) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                leftArea[bin] = accumulated.surfaceArea();
+                leftCount[bin] = accumulatedCount;
+            }
+
+            // sweep from the right and evaluate the cost of every split plane
+            accumulated = BoundingBox::empty();
+            accumulatedCount = 0;
+            for (unsigned bin = binCount - 1; bin > 0; bin--) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                if (leftCount[bin - 1] == 0 || accumulatedCount == 0) {
+                    continue;
+                }
+                float cost = settings.traversalCost + settings.intersectionCost *
+                             (leftArea[bin - 1] * (float) leftCount[bin - 1] +
+                              accumulated.surfaceArea() * (float) accumulatedCount) / parentArea;
+                if (cost < best.cost) {
+                    best = {cost, axis, bin - 1};
+                }
+            }
+        }
+        return best;
+    }
+}
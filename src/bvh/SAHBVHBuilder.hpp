@@ -0,0 +1,92 @@
+#pragma once
+#include "BVHBuilder.hpp"
+
+namespace RayTracing {
+    /**
+     * Builder using a binned surface area heuristic (SAH).
+     * Every node evaluates a fixed number of centroid bins on all three axes and picks the split with the lowest
+     * expected cost, a leaf is created as soon as intersecting all triangles is cheaper than any split.
+     * Triangles are never duplicated, each one is referenced by exactly one leaf.
+     * Large nodes are binned and partitioned in fixed size chunks distributed over tasks and subtrees are built as
+     * separate tasks. The partition is stable and the chunking does not depend on the number of threads, so every
+     * thread count produces the same hierarchy.
+     */
+    class SAHBVHBuilder : public BVHBuilder {
+    private:
+        /// Triangle reference with precomputed bounds used during the build
+        struct BuildTriangle {
+            BoundingBox bounds;
+            Vec3 centroid;
+            unsigned triangle;
+        };
+
+        /// Bounds and triangle counts of the centroid bins of all three axes, bin b of axis a is at a * binCount + b
+        struct Bins {
+            std::vector<BoundingBox> bounds;
+            std::vector<unsigned> counts;
+
+            explicit Bins(unsigned binCount) : bounds(3 * binCount, BoundingBox::empty()), counts(3 * binCount, 0) {
+            }
+
+            void merge(const Bins &other) {
+                for (unsigned i = 0; i < bounds.size(); i++) {
+                    bounds[i].grow(other.bounds[i]);
+                    counts[i] += other.counts[i];
+                }
+            }
+        };
+
+        /// Best split found for a node
+        struct Split {
+            float cost = INFINITY;
+            Vec3::Direction axis = Vec3::X_AXIS;
+            /// triangles in bins [0, bin] go to the left child
+            unsigned bin = 0;
+        };
+
+        /// number of triangles processed by one task while binning and partitioning a node
+        static constexpr unsigned CHUNK_SIZE = 4096;
+
+        const Mesh *mesh = nullptr;
+        std::vector<BuildTriangle> triangles;
+        /// target buffer of the chunked partition, same size as triangles
+        std::vector<BuildTriangle> scratch;
+
+        /// Get the number of chunks triangles[begin, end) is split into
+        [[nodiscard]] static unsigned chunkCount(unsigned begin, unsigned end) {
+            return (end - begin + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        }
+
+        /// Calculate the bounds of the triangles and of their centroids for triangles[begin, end)
+        void calculateBounds(unsigned begin, unsigned end, BoundingBox &bounds, BoundingBox &centroidBounds) const;
+
+        /// Add triangles[begin, end) to the bins of all axes with a non-zero centroid extent
+        void binTriangles(unsigned begin, unsigned end, const BoundingBox &centroidBounds, Bins &bins) const;
+
+        /// Stable partition of triangles[begin, end) into the two sides of a split, returns the first right triangle
+        unsigned partitionTriangles(unsigned begin, unsigned end, const Split &split,
+                                    const BoundingBox &centroidBounds);
+
+        /// Recursively build the node for triangles[begin, end)
+        NestedBoundingBox *buildRecursive(unsigned begin, unsigned end, unsigned depth);
+
+        /// Create a leaf referencing triangles[begin, end), which is the same range in the final triangle order
+        static NestedBoundingBox *createLeaf(unsigned begin, unsigned end, const BoundingBox &bounds);
+
+        /// Evaluate the binned SAH on all axes for triangles[begin, end)
+        [[nodiscard]] Split findBestSplit(unsigned begin, unsigned end, const BoundingBox &bounds,
+                                          const BoundingBox &centroidBounds) const;
+
+        /// Get the bin of a centroid along an axis
+        [[nodiscard]] unsigned binOf(const Vec3 &centroid, Vec3::Direction axis,
+                                     const BoundingBox &centroidBounds) const;
+
+    public:
+        explicit SAHBVHBuilder(const BVHBuildSettings &settings) : BVHBuilder(settings) {
+        }
+
+        NestedBoundingBox *build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) override;
+
+        std::string identifier() override { return "SAHBVHBuilder"; }
+    };
+}
@@ -0,0 +1,377 @@
+#include "SBVHBuilder.hpp"
+
+#include <algorithm>
+
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    NestedBoundingBox *SBVHBuilder::build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) {
+        this->mesh = &mesh;
+        this->triangleOrder = &triangleOrder;
+        triangleOrder.clear();
+        std::vector<Reference> references(mesh.numTriangles);
+        BoundingBox rootBounds = BoundingBox::empty();
+        for (unsigned triangle = 0; triangle < mesh.numTriangles; triangle++) {
+            BoundingBox bounds = BoundingBox::empty();
+            for (int i = 0; i < 3; i++) {
+                bounds.grow(mesh.vertices[mesh.indices[triangle * 3 + i]]);
+            }
+            references[triangle] = {bounds, triangle};
+            rootBounds.grow(bounds);
+        }
+        rootArea = rootBounds.surfaceArea();
+        auto budget = (unsigned) (settings.sbvhDuplicateBudget * (float) mesh.numTriangles);
+
+        NestedBoundingBox *root = nullptr;
+#pragma omp parallel num_threads((int) buildThreadCount()) default(shared)
+#pragma omp single
+        root = buildRecursive(std::move(references), budget, 1);
+        // leaves were appended by concurrent tasks, renumber them to get the same order for every thread count
+        orderLeavesDepthFirst(root, triangleOrder);
+
+        this->mesh = nullptr;
+        this->triangleOrder = nullptr;
+        return root;
+    }
+
+    NestedBoundingBox *SBVHBuilder::buildRecursive(std::vector<Reference> references, unsigned budget,
+                                                   unsigned depth) {
+        BoundingBox bounds = BoundingBox::empty();
+        BoundingBox centroidBounds = BoundingBox::empty();
+        for (const auto &reference: references) {
+            bounds.grow(reference.bounds);
+            centroidBounds.grow(reference.bounds.center());
+        }
+
+        const auto count = (unsigned) references.size();
+        if (count <= 1 || depth >= settings.maxDepth) {
+            return createLeaf(references, bounds);
+        }
+
+        Split objectSplit = findObjectSplit(references, bounds, centroidBounds);
+        Split spatialSplit;
+        if (budget > 0) {
+            // spatial splits only pay off if the children of the object split overlap
+            float overlap = objectSplit.cost < INFINITY
+                                ? objectSplit.leftBounds.intersection(objectSplit.rightBounds).surfaceArea()
+                                : bounds.surfaceArea();
+            if (overlap > settings.sbvhOverlapThreshold * rootArea) {
+                spatialSplit = findSpatialSplit(references, bounds);
+            }
+        }
+
+        float leafCost = settings.intersectionCost * (float) count;
+        float bestCost = std::min(objectSplit.cost, spatialSplit.cost);
+        if (bestCost >= leafCost && count <= settings.maxTrianglesPerLeaf) {
+            return createLeaf(references, bounds);
+        }
+
+        std::vector<Reference> left;
+        std::vector<Reference> right;
+        unsigned duplicates = 0;
+        Vec3::Direction splitAxis = Vec3::X_AXIS;
+        float splitValue = 0;
+        if (spatialSplit.cost < objectSplit.cost) {
+            duplicates = partitionSpatialSplit(references, spatialSplit, budget, left, right);
+            splitAxis = spatialSplit.axis;
+            splitValue = spatialSplit.position;
+            if (left.empty() || right.empty()) {
+                // all references ended up on one side, do not recurse without progress
+                left.clear();
+                right.clear();
+                duplicates = 0;
+            }
+        }
+        if (left.empty() && right.empty()) {
+            if (objectSplit.cost < INFINITY) {
+                partitionObjectSplit(references, objectSplit, centroidBounds, left, right);
+                splitAxis = objectSplit.axis;
+                splitValue = centroidBounds.minPos[objectSplit.axis] + centroidBounds.size()[objectSplit.axis] *
+                             (float) (objectSplit.bin + 1) / (float) settings.sahBinCount;
+            } else {
+                // all centroids fall into one bin but the leaf would be too large, split by count instead
+                Vec3 extent = centroidBounds.size();
+                splitAxis = extent[Vec3::X_AXIS] > extent[Vec3::Y_AXIS]
+                                ? (extent[Vec3::X_AXIS] > extent[Vec3::Z_AXIS] ? Vec3::X_AXIS : Vec3::Z_AXIS)
+                                : (extent[Vec3::Y_AXIS] > extent[Vec3::Z_AXIS] ? Vec3::Y_AXIS : Vec3::Z_AXIS);
+                unsigned mid = count / 2;
+                std::nth_element(references.begin(), references.begin() + mid, references.end(),
+                                 [&](const Reference &a, const Reference &b) {
+                                     return a.bounds.center()[splitAxis] < b.bounds.center()[splitAxis];
+                                 });
+                splitValue = references[mid].bounds.center()[splitAxis];
+                left.assign(references.begin(), references.begin() + mid);
+                right.assign(references.begin() + mid, references.end());
+            }
+        }
+        std::vector<Reference>().swap(references);
+
+        // hand the remaining budget to the children by their share of references
+        unsigned remaining = budget - duplicates;
+        auto leftBudget = (unsigned) ((unsigned long long) remaining * left.size() / (left.size() + right.size()));
+        unsigned rightBudget = remaining - leftBudget;
+
+        NestedBoundingBox *leftChild;
+        NestedBoundingBox *rightChild;
+        if (count >= PARALLEL_SUBTREE_THRESHOLD) {
+            // both children own their references, the left one is built in a separate task
+#pragma omp task default(shared)
+            leftChild = buildRecursive(std::move(left), leftBudget, depth + 1);
+            rightChild = buildRecursive(std::move(right), rightBudget, depth + 1);
+#pragma omp taskwait
+        } else {
+            leftChild = buildRecursive(std::move(left), leftBudget, depth + 1);
+            rightChild = buildRecursive(std::move(right), rightBudget, depth + 1);
+        }
+
+        return new NestedBoundingBox{bounds, 0, 0, leftChild, rightChild, splitValue, splitAxis};
+    }
+
+    NestedBoundingBox *SBVHBuilder::createLeaf(const std::vector<Reference> &references,
+                                               const BoundingBox &bounds) {
+        unsigned offset;
+#pragma omp critical(sbvhTriangleOrder)
+        {
+            offset = triangleOrder->size();
+            for (const auto &reference: references) {
+                triangleOrder->push_back(reference.triangle);
+            }
+        }
+        return new NestedBoundingBox{bounds, offset, (unsigned) references.size(), nullptr, nullptr, 0, Vec3::X_AXIS};
+    }
+
+    unsigned SBVHBuilder::binOf(float value, float minimum, float extent) const {
+        auto bin = (int) ((float) settings.sahBinCount * (value - minimum) / extent);
+        return (unsigned) std::clamp(bin, 0, (int) settings.sahBinCount - 1);
+    }
+
+    SBVHBuilder::Split SBVHBuilder::findObjectSplit(const std::vector<Reference> &references,
+                                                    const BoundingBox &bounds,
+                                                    const BoundingBox &centroidBounds) const {
+        const unsigned binCount = settings.sahBinCount;
+        std::vector binBounds(binCount, BoundingBox::empty());
+        std::vector<unsigned> binCounts(binCount);
+        std::vector<BoundingBox> leftBounds(binCount);
+        std::vector<unsigned> leftCount(binCount);
+        float parentArea = bounds.surfaceArea();
+
+        Split best;
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            float extent = centroidBounds.maxPos[axis] - centroidBounds.minPos[axis];
+            if (extent <= 0) {
+                continue; // all centroids on one plane, no split possible along this axis
+            }
+            std::fill(binBounds.begin(), binBounds.end(), BoundingBox::empty());
+            std::fill(binCounts.begin(), binCounts.end(), 0);
+            for (const auto &reference: references) {
+                unsigned bin = binOf(reference.bounds.center()[axis], centroidBounds.minPos[axis], extent);
+                binBounds[bin].grow(reference.bounds);
+                binCounts[bin]++;
+            }
+
+            // sweep from the left to get bounds and count left of every split plane
+            BoundingBox accumulated = BoundingBox::empty();
+            unsigned accumulatedCount = 0;
+            for (unsigned bin = 0; bin < binCount - 1; bin++) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                leftBounds[bin] = accumulated;
+                leftCount[bin] = accumulatedCount;
+            }
+
+            // sweep from the right and evaluate the cost of every split plane
+            accumulated = BoundingBox::empty();
+            accumulatedCount = 0;
+            for (unsigned bin = binCount - 1; bin > 0; bin--) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                if (leftCount[bin - 1] == 0 || accumulatedCount == 0) {
+                    continue;
+                }
+                float cost = settings.traversalCost + settings.intersectionCost *
+                             (leftBounds[bin - 1].surfaceArea() * (float) leftCount[bin - 1] +
+                              accumulated.surfaceArea() * (float) accumulatedCount) / parentArea;
+                if (cost < best.cost) {
+                    best = {cost, axis, bin - 1, 0, leftBounds[bin - 1], accumulated};
+                }
+            }
+        }
+        return best;
+    }
+
+    SBVHBuilder::Split SBVHBuilder::findSpatialSplit(const std::vector<Reference> &references,
+                                                     const BoundingBox &bounds) const {
+        const unsigned binCount = settings.sahBinCount;
+        std::vector binBounds(binCount, BoundingBox::empty());
+        std::vector<unsigned> entries(binCount);
+        std::vector<unsigned> exits(binCount);
+        std::vector<BoundingBox> leftBounds(binCount);
+        std::vector<unsigned> leftCount(binCount);
+        float parentArea = bounds.surfaceArea();
+
+        Split best;
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            const float minimum = bounds.minPos[axis];
+            const float extent = bounds.maxPos[axis] - minimum;
+            if (extent <= 0) {
+                continue;
+            }
+            std::fill(binBounds.begin(), binBounds.end(), BoundingBox::empty());
+            std::fill(entries.begin(), entries.end(), 0);
+            std::fill(exits.begin(), exits.end(), 0);
+
+            // chop every reference at the bin planes it crosses, counting where it enters and exits
+            for (const auto &reference: references) {
+                unsigned firstBin = binOf(reference.bounds.minPos[axis], minimum, extent);
+                unsigned lastBin = binOf(reference.bounds.maxPos[axis], minimum, extent);
+                Reference remaining = reference;
+                for (unsigned bin = firstBin; bin < lastBin; bin++) {
+                    Reference binPart;
+                    Reference rest;
+                    float plane = minimum + extent * (float) (bin + 1) / (float) binCount;
+                    splitReference(remaining, axis, plane, binPart, rest);
+                    binBounds[bin].grow(binPart.bounds);
+                    remaining = rest;
+                }
+                binBounds[lastBin].grow(remaining.bounds);
+                entries[firstBin]++;
+                exits[lastBin]++;
+            }
+
+            BoundingBox accumulated = BoundingBox::empty();
+            unsigned accumulatedCount = 0;
+            for (unsigned bin = 0; bin < binCount - 1; bin++) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += entries[bin];
+                leftBounds[bin] = accumulated;
+                leftCount[bin] = accumulatedCount;
+            }
+
+            accumulated = BoundingBox::empty();
+            accumulatedCount = 0;
+            for (unsigned bin = binCount - 1; bin > 0; bin--) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += exits[bin];
+                if (leftCount[bin - 1] == 0 || accumulatedCount == 0) {
+                    continue;
+                }
+                float cost = settings.traversalCost + settings.intersectionCost *
+                             (leftBounds[bin - 1].surfaceArea() * (float) leftCount[bin - 1] +
+                              accumulated.surfaceArea() * (float) accumulatedCount) / parentArea;
+                if (cost < best.cost) {
+                    best = {
+                        cost, axis, bin - 1, minimum + extent * (float) bin / (float) binCount, leftBounds[bin - 1],
+                        accumulated
+                    };
+                }
+            }
+        }
+        return best;
+    }
+
+    void SBVHBuilder::partitionObjectSplit(const std::vector<Reference> &references, const Split &split,
+                                           const BoundingBox &centroidBounds, std::vector<Reference> &left,
+                                           std::vector<Reference> &right) const {
+        const float minimum = centroidBounds.minPos[split.axis];
+        const float extent = centroidBounds.maxPos[split.axis] - minimum;
+        for (const auto &reference: references) {
+            if (binOf(reference.bounds.center()[split.axis], minimum, extent) <= split.bin) {
+                left.push_back(reference);
+            } else {
+                right.push_back(reference);
+            }
+        }
+    }
+
+    unsigned SBVHBuilder::partitionSpatialSplit(const std::vector<Reference> &references, const Split &split,
+                                                unsigned budget, std::vector<Reference> &left,
+                                                std::vector<Reference> &right) const {
+        const Vec3::Direction axis = split.axis;
+        const float position = split.position;
+        std::vector<const Reference *> straddling;
+        BoundingBox leftBounds = BoundingBox::empty();
+        BoundingBox rightBounds = BoundingBox::empty();
+        for (const auto &reference: references) {
+            if (reference.bounds.maxPos[axis] <= position) {
+                left.push_back(reference);
+                leftBounds.grow(reference.bounds);
+            } else if (reference.bounds.minPos[axis] >= position) {
+                right.push_back(reference);
+                rightBounds.grow(reference.bounds);
+            } else {
+                straddling.push_back(&reference);
+            }
+        }
+
+        // decide for every straddling reference if splitting it beats moving it to one side completely
+        unsigned duplicates = 0;
+        auto leftCount = (float) (left.size() + straddling.size());
+        auto rightCount = (float) (right.size() + straddling.size());
+        for (const Reference *reference: straddling) {
+            Reference leftPart;
+            Reference rightPart;
+            splitReference(*reference, axis, position, leftPart, rightPart);
+            BoundingBox splitLeft = leftBounds;
+            BoundingBox splitRight = rightBounds;
+            splitLeft.grow(leftPart.bounds);
+            splitRight.grow(rightPart.bounds);
+            BoundingBox allLeft = leftBounds;
+            BoundingBox allRight = rightBounds;
+            allLeft.grow(reference->bounds);
+            allRight.grow(reference->bounds);
+
+            float splitCost = splitLeft.surfaceArea() * leftCount + splitRight.surfaceArea() * rightCount;
+            // moving the whole reference to one side leaves the bounds of the other side unchanged
+            float leftCost = allLeft.surfaceArea() * leftCount + rightBounds.surfaceArea() * (rightCount - 1);
+            float rightCost = leftBounds.surfaceArea() * (leftCount - 1) + allRight.surfaceArea() * rightCount;
+            bool canSplit = duplicates < budget && !leftPart.bounds.isEmpty() && !rightPart.bounds.isEmpty();
+            if (canSplit && splitCost < leftCost && splitCost < rightCost) {
+                left.push_back(leftPart);
+                right.push_back(rightPart);
+                leftBounds = splitLeft;
+                rightBounds = splitRight;
+                duplicates++;
+            } else if (leftCost <= rightCost) {
+                left.push_back(*reference);
+                leftBounds = allLeft;
+                rightCount--;
+            } else {
+                right.push_back(*reference);
+                rightBounds = allRight;
+                leftCount--;
+            }
+        }
+        return duplicates;
+    }
+
+    void SBVHBuilder::splitReference(const Reference &reference, Vec3::Direction axis, float position,
+                                     Reference &left, Reference &right) const {
+        left = {BoundingBox::empty(), reference.triangle};
+        right = {BoundingBox::empty(), reference.triangle};
+        const int *triangle = &mesh->indices[reference.triangle * 3];
+        for (int i = 0; i < 3; i++) {
+            const Vec3 &start = mesh->vertices[triangle[i]];
+            const Vec3 &end = mesh->vertices[triangle[(i + 1) % 3]];
+            const float startValue = start[axis];
+            const float endValue = end[axis];
+            if (startValue <= position) {
+                left.bounds.grow(start);
+            }
+            if (startValue >= position) {
+                right.bounds.grow(start);
+            }
+            if ((startValue < position && endValue > position) || (startValue > position && endValue < position)) {
+                // edge crosses the plane, the crossing point belongs to both sides
+                Vec3 crossing = start + (end - start) * ((position - startValue) / (endValue - startValue));
+                crossing[axis] = position;
+                left.bounds.grow(crossing);
+                right.bounds.grow(crossing);
+            }
+        }
+        // the reference may already be clipped by an earlier split, keep both parts within it
+        left.bounds.maxPos[axis] = std::min(left.bounds.maxPos[axis], position);
+        right.bounds.minPos[axis] = std::max(right.bounds.minPos[axis], position);
+        left.bounds = left.bounds.intersection(reference.bounds);
+        right.bounds = right.bounds.intersection(reference.bounds);
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "BVHBuilder.hpp"
+
+namespace RayTracing {
+    /**
+     * Spatial split bounding volume hierarchy builder (SBVH).
+     * Every node evaluates binned object splits like the SAH builder and, if the children of the best object split
+     * overlap noticeably, additionally binned spatial splits. A spatial split clips the references of straddling
+     * triangles to both sides of the split plane, so both children get tight boxes and a triangle can end up in
+     * several leaves. The number of additional references is limited by BVHBuildSettings::sbvhDuplicateBudget, the
+     * budget left at a node is divided between its children by their reference count.
+     * Subtrees are built as separate tasks, the result does not depend on the number of threads.
+     */
+    class SBVHBuilder : public BVHBuilder {
+    private:
+        /// Reference to a triangle, bounds are clipped to the part of the triangle inside the node
+        struct Reference {
+            BoundingBox bounds;
+            unsigned triangle;
+        };
+
+        /// Best split found for a node
+        struct Split {
+            float cost = INFINITY;
+            Vec3::Direction axis = Vec3::X_AXIS;
+            /// object split: centroid bin of the last left reference, spatial split: bin left of the split plane
+            unsigned bin = 0;
+            /// position of the split plane, only used by spatial splits
+            float position = 0;
+            /// bounds of both children, used to decide if a spatial split is worth evaluating
+            BoundingBox leftBounds = BoundingBox::empty();
+            BoundingBox rightBounds = BoundingBox::empty();
+        };
+
+        const Mesh *mesh = nullptr;
+        /// triangle order the leaves are appended to while building
+        std::vector<unsigned> *triangleOrder = nullptr;
+        /// surface area of the root node, overlaps are measured relative to it
+        float rootArea = 0;
+
+        /// Recursively build the node for the given references with budget for additional references
+        NestedBoundingBox *buildRecursive(std::vector<Reference> references, unsigned budget, unsigned depth);
+
+        /// Create a leaf and append the triangles of the references to the triangle order
+        NestedBoundingBox *createLeaf(const std::vector<Reference> &references, const BoundingBox &bounds);
+
+        /// Evaluate the binned SAH on the reference centroids of all axes
+        [[nodiscard]] Split findObjectSplit(const std::vector<Reference> &references, const BoundingBox &bounds,
+                                            const BoundingBox &centroidBounds) const;
+
+        /// Evaluate binned spatial splits of the node bounds on all axes
+        [[nodiscard]] Split findSpatialSplit(const std::vector<Reference> &references,
+                                             const BoundingBox &bounds) const;
+
+        /// Split the references by the centroid bin of an object split
+        void partitionObjectSplit(const std::vector<Reference> &references, const Split &split,
+                                  const BoundingBox &centroidBounds, std::vector<Reference> &left,
+                                  std::vector<Reference> &right) const;
+
+        /**
+         * Split the references at the plane of a spatial split.
+         * Straddling references are clipped to both sides, unless moving them to one side completely is cheaper.
+         * @return number of additional references created
+         */
+        unsigned partitionSpatialSplit(const std::vector<Reference> &references, const Split &split,
+                                       unsigned budget, std::vector<Reference> &left,
+                                       std::vector<Reference> &right) const;
+
+        /// Clip a reference at a plane into the parts left and right of it
+        void splitReference(const Reference &reference, Vec3::Direction axis, float position,
+                            Reference &left, Reference &right) const;
+
+        /// Get the bin of a centroid along an axis
+        [[nodiscard]] unsigned binOf(float value, float minimum, float extent) const;
+
+    public:
+        explicit SBVHBuilder(const BVHBuildSettings &settings) : BVHBuilder(settings) {
+        }
+
+        NestedBoundingBox *build(const Mesh &mesh, std::vector<unsigned> &triangleOrder) override;
+
+        std::string identifier() override { return "SBVHBuilder"; }
+    };
+}
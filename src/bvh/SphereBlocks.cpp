@@ -0,0 +1,90 @@
+#include "SphereBlocks.hpp"
+
+#include <bit>
+
+namespace RayTracing {
+    void SphereBlocks::clear() {
+        blocks.clear();
+    }
+
+    unsigned SphereBlocks::add() {
+        blocks.emplace_back();
+        return blocks.size() - 1;
+    }
+
+    void SphereBlocks::set(unsigned block, unsigned lane, const Vec3 &center, float radius, uint32_t object,
+                           bool light) {
+        SphereBlock<SPHERE_BLOCK_WIDTH> &target = blocks[block];
+        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+            target.center[axis][lane] = center[axis];
+        }
+        target.radius[lane] = radius;
+        target.object[lane] = object;
+        target.usedMask |= 1u << lane;
+        target.lightMask = light ? target.lightMask | 1u << lane : target.lightMask & ~(1u << lane);
+    }
+
+    /**
+     * Quadratic ray sphere test of all lanes of a block
+     * @param distance set to the distance along the ray of every lane
+     * @return mask of the used lanes that are hit in front of the ray closer than maxDistance
+     */
+    template<unsigned Width>
+    static unsigned intersectLanes(const Ray &ray, const SphereBlock<Width> &block, float maxDistance,
+                                   typename FloatLanes<Width>::Type &distance) {
+        using Lanes = typename FloatLanes<Width>::Type;
+        const Lanes zero = Lanes::broadcast(0);
+        const Lanes two = Lanes::broadcast(2);
+        Lanes offset[3];
+        for (unsigned axis = 0; axis < 3; axis++) {
+            offset[axis] = Lanes::broadcast(ray.origin[axis]) - Lanes::load(block.center[axis]);
+        }
+        Lanes direction[3] = {
+            Lanes::broadcast(ray.direction[0]), Lanes::broadcast(ray.direction[1]), Lanes::broadcast(ray.direction[2])
+        };
+        Lanes radius = Lanes::load(block.radius);
+
+        // the quadratic coefficient only depends on the ray
+        float a = Vec3::dot(ray.direction, ray.direction);
+        Lanes b = two * (offset[0] * direction[0] + offset[1] * direction[1] + offset[2] * direction[2]);
+        Lanes c = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] - radius * radius;
+        Lanes discriminant = b * b - Lanes::broadcast(4 * a) * c;
+        distance = (Lanes::broadcast(-1) * b - Lanes::sqrt(discriminant)) / Lanes::broadcast(2 * a);
+
+        return Lanes::lessEqualMask(zero, discriminant) & Lanes::lessEqualMask(zero, distance) &
+               Lanes::lessMask(distance, Lanes::broadcast(maxDistance)) & block.usedMask;
+    }
+
+    int SphereBlocks::intersect(const Ray &ray, unsigned block, float maxDistance, HitInfo &hit) const {
+        const SphereBlock<SPHERE_BLOCK_WIDTH> &spheres = blocks[block];
+        typename FloatLanes<SPHERE_BLOCK_WIDTH>::Type distance;
+        unsigned mask = intersectLanes(ray, spheres, maxDistance, distance);
+        if (mask == 0) {
+            return -1;
+        }
+
+        float distances[SPHERE_BLOCK_WIDTH];
+        distance.store(distances);
+        int closest = -1;
+        for (unsigned lanes = mask; lanes != 0; lanes &= lanes - 1) {
+            int lane = std::countr_zero(lanes);
+            if (closest < 0 || distances[lane] < distances[closest]) {
+                closest = lane;
+            }
+        }
+        Vec3 center = {spheres.center[0][closest], spheres.center[1][closest], spheres.center[2][closest]};
+        hit = {
+            .hit = true,
+            .hitPoint = ray.origin + (ray.direction * distances[closest]),
+            .normal = (ray.origin + (ray.direction * distances[closest]) - center).normalized(),
+            .distance = distances[closest]
+        };
+        return closest;
+    }
+
+    bool SphereBlocks::occluded(const Ray &ray, unsigned block, float maxDistance) const {
+        const SphereBlock<SPHERE_BLOCK_WIDTH> &spheres = blocks[block];
+        typename FloatLanes<SPHERE_BLOCK_WIDTH>::Type distance;
+        return (intersectLanes(ray, spheres, maxDistance, distance) & ~spheres.lightMask) != 0;
+    }
+}
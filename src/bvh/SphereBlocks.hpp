@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../Ray.hpp"
+#include "../math/simd.hpp"
+
+namespace RayTracing {
+#if defined(RAYTRACER_SIMD_AVX) || defined(RAYTRACER_SIMD_NEON)
+    /// number of spheres tested at once, one AVX register or a pair of NEON registers
+    constexpr unsigned SPHERE_BLOCK_WIDTH = 8;
+#else
+    /// number of spheres tested at once, one SSE register
+    constexpr unsigned SPHERE_BLOCK_WIDTH = 4;
+#endif
+
+    /**
+     * Centers and radii of up to Width spheres and light sources, stored as structure of arrays per coordinate.
+     * Lanes outside of usedMask are never hit.
+     */
+    template<unsigned Width>
+    struct alignas(32) SphereBlock {
+        float center[3][Width];
+        float radius[Width];
+        /// index of the sphere or light source of every lane in the scene
+        uint32_t object[Width];
+        /// lanes holding a sphere or light source
+        uint32_t usedMask;
+        /// lanes holding a light source, all other used lanes hold spheres
+        uint32_t lightMask;
+    };
+
+    /**
+     * Spheres and light sources of a scene compiled into blocks for the SIMD sphere test.
+     * The top level hierarchy groups nearby spheres and light sources into one leaf per block, so a leaf is
+     * intersected with one SIMD pass instead of one scalar test per object.
+     */
+    class SphereBlocks {
+    private:
+        std::vector<SphereBlock<SPHERE_BLOCK_WIDTH> > blocks;
+
+    public:
+        /// Release all blocks
+        void clear();
+
+        /**
+         * Append a block without spheres
+         * @return index of the new block
+         */
+        unsigned add();
+
+        /**
+         * Set a lane of a block to a sphere or light source
+         * @param block index of the block
+         * @param lane lane to set, less than SPHERE_BLOCK_WIDTH
+         * @param center center of the sphere in world space
+         * @param radius radius of the sphere
+         * @param object index of the sphere or light source in the scene
+         * @param light true if object is a light source
+         */
+        void set(unsigned block, unsigned lane, const Vec3 &center, float radius, uint32_t object, bool light);
+
+        const SphereBlock<SPHERE_BLOCK_WIDTH> &operator[](unsigned block) const { return blocks[block]; }
+
+        /**
+         * Find the closest sphere or light source of a block hit by a ray, testing all lanes in one SIMD pass with the
+         * operations of Ray::intersectSphere in the same order
+         * @param ray ray in world space
+         * @param block index of the block
+         * @param maxDistance only hits closer than this distance count
+         * @param hit set to the intersection with the closest sphere if one is hit
+         * @return lane of the closest sphere, -1 if none is hit
+         */
+        int intersect(const Ray &ray, unsigned block, float maxDistance, HitInfo &hit) const;
+
+        /**
+         * Check if a ray hits any sphere of a block closer than maxDistance, light sources are ignored
+         * @param ray ray in world space
+         * @param block index of the block
+         * @param maxDistance only hits closer than this distance count
+         * @return true if a sphere is hit
+         */
+        [[nodiscard]] bool occluded(const Ray &ray, unsigned block, float maxDistance) const;
+
+        /// Get the memory used by the blocks in bytes
+        [[nodiscard]] size_t memoryUsage() const { return blocks.size() * sizeof(SphereBlock<SPHERE_BLOCK_WIDTH>); }
+    };
+}
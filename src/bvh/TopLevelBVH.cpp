@@ -0,0 +1,192 @@
+#include "TopLevelBVH.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace RayTracing {
+    BoundingBox TopLevelBVH::worldBounds(const MeshedRayTraceableObject &object) {
+        BoundingBox bounds = BoundingBox::empty();
+        if (object.boundingBox.isEmpty()) {
+            return bounds;
+        }
+        const BoundingBox &local = object.boundingBox;
+        for (unsigned corner = 0; corner < 8; corner++) {
+            Vec3 localCorner = {
+                (corner & 1) ? local.maxPos.getX() : local.minPos.getX(),
+                (corner & 2) ? local.maxPos.getY() : local.minPos.getY(),
+                (corner & 4) ? local.maxPos.getZ() : local.minPos.getZ()
+            };
+            bounds.grow(object.transform.getLocalToWorldPosition(localCorner));
+        }
+        return bounds;
+    }
+
+    BoundingBox TopLevelBVH::worldBounds(const SphereRayTraceableObject &sphere) {
+        Vec3 center = sphere.transform.getTranslation();
+        Vec3 radius = Vec3(sphere.radius);
+        return {center - radius, center + radius};
+    }
+
+    void TopLevelBVH::build(const std::vector<MeshedRayTraceableObject *> &objects,
+                            const std::vector<SphereRayTraceableObject *> &spheres,
+                            const std::vector<LightSource *> &lights) {
+        nodes.clear();
+        instances.clear();
+        sphereBlocks.clear();
+        depth = 0;
+        buildInstances.clear();
+
+        for (unsigned i = 0; i < objects.size(); i++) {
+            BoundingBox bounds = worldBounds(*objects[i]);
+            if (!bounds.isEmpty()) {
+                buildInstances.push_back({bounds, bounds.center(), {TopLevelInstance::Type::MESH, i}, false, 0});
+            }
+        }
+        for (unsigned i = 0; i < spheres.size(); i++) {
+            buildInstances.push_back({
+                worldBounds(*spheres[i]), spheres[i]->transform.getTranslation(),
+                {TopLevelInstance::Type::SPHERES, i}, false, spheres[i]->radius
+            });
+        }
+        for (unsigned i = 0; i < lights.size(); i++) {
+            buildInstances.push_back({
+                worldBounds(*lights[i]), lights[i]->transform.getTranslation(),
+                {TopLevelInstance::Type::SPHERES, i}, true, lights[i]->radius
+            });
+        }
+        objectCount = buildInstances.size();
+
+        if (!buildInstances.empty()) {
+            nodes.reserve(2 * buildInstances.size() - 1);
+            instances.reserve(buildInstances.size());
+            buildRecursive(0, buildInstances.size(), 1);
+        }
+        buildInstances.clear();
+        builtSAHCost = LinearBVH::sahCost(nodes, 1, 1);
+    }
+
+    bool TopLevelBVH::refit(const std::vector<MeshedRayTraceableObject *> &objects,
+                            const std::vector<SphereRayTraceableObject *> &spheres,
+                            const std::vector<LightSource *> &lights, float rebuildThreshold) {
+        if (objectCount != objects.size() + spheres.size() + lights.size()) {
+            build(objects, spheres, lights);
+            return true;
+        }
+        for (auto &node: nodes) {
+            if (!node.isLeaf()) {
+                continue;
+            }
+            const TopLevelInstance &instance = instances[node.trianglesOffset];
+            switch (instance.type) {
+                case TopLevelInstance::Type::MESH:
+                    node.bounds = worldBounds(*objects[instance.index]);
+                    break;
+                case TopLevelInstance::Type::SPHERES: {
+                    const auto &block = sphereBlocks[instance.index];
+                    node.bounds = BoundingBox::empty();
+                    for (unsigned lanes = block.usedMask; lanes != 0; lanes &= lanes - 1) {
+                        unsigned lane = std::countr_zero(lanes);
+                        bool light = (block.lightMask >> lane) & 1;
+                        const SphereRayTraceableObject *sphere = light
+                                                                     ? lights[block.object[lane]]
+                                                                     : spheres[block.object[lane]];
+                        sphereBlocks.set(instance.index, lane, sphere->transform.getTranslation(), sphere->radius,
+                                         block.object[lane], light);
+                        node.bounds.grow(worldBounds(*sphere));
+                    }
+                    break;
+                }
+            }
+            if (node.bounds.isEmpty()) {
+                // the mesh lost its geometry, rebuild to drop its instance
+                build(objects, spheres, lights);
+                return true;
+            }
+        }
+        LinearBVH::refitInnerNodes(nodes);
+        if (LinearBVH::sahCost(nodes, 1, 1) > builtSAHCost * rebuildThreshold) {
+            build(objects, spheres, lights);
+            return true;
+        }
+        return false;
+    }
+
+    unsigned TopLevelBVH::buildRecursive(unsigned begin, unsigned end, unsigned currentDepth) {
+        depth = std::max(depth, currentDepth);
+        unsigned nodeIndex = nodes.size();
+        nodes.emplace_back();
+
+        BoundingBox bounds = BoundingBox::empty();
+        for (unsigned i = begin; i < end; i++) {
+            bounds.grow(buildInstances[i].bounds);
+        }
+        nodes[nodeIndex].bounds = bounds;
+
+        unsigned count = end - begin;
+        // a few spheres and light sources are tested in one SIMD pass, cheaper than splitting them any further
+        bool sphereLeaf = count <= SPHERE_BLOCK_WIDTH &&
+                          std::all_of(buildInstances.begin() + begin, buildInstances.begin() + end,
+                                      [](const BuildInstance &instance) {
+                                          return instance.instance.type == TopLevelInstance::Type::SPHERES;
+                                      });
+        if (count == 1 || sphereLeaf) {
+            nodes[nodeIndex].trianglesOffset = instances.size();
+            nodes[nodeIndex].triangleCount = 1;
+            nodes[nodeIndex].splitAxis = 0;
+            if (sphereLeaf) {
+                unsigned block = sphereBlocks.add();
+                for (unsigned i = begin; i < end; i++) {
+                    const BuildInstance &sphere = buildInstances[i];
+                    sphereBlocks.set(block, i - begin, sphere.centroid, sphere.radius, sphere.instance.index,
+                                     sphere.light);
+                }
+                instances.push_back({TopLevelInstance::Type::SPHERES, block});
+            } else {
+                instances.push_back(buildInstances[begin].instance);
+            }
+            return nodeIndex;
+        }
+
+        auto sortAlong = [&](Vec3::Direction axis) {
+            std::stable_sort(buildInstances.begin() + begin, buildInstances.begin() + end,
+                             [axis](const BuildInstance &a, const BuildInstance &b) {
+                                 return a.centroid[axis] < b.centroid[axis];
+                             });
+        };
+
+        // sweep over the instances sorted along every axis and split where the surface area heuristic is lowest,
+        // deep nodes are split in the middle to keep the depth within the traversal stack size
+        Vec3::Direction bestAxis = Vec3::X_AXIS;
+        unsigned mid = begin + count / 2;
+        if (currentDepth < LINEAR_BVH_MAX_DEPTH / 2) {
+            float bestCost = INFINITY;
+            std::vector<float> rightArea(count);
+            for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                sortAlong(axis);
+                BoundingBox accumulated = BoundingBox::empty();
+                for (unsigned i = count - 1; i > 0; i--) {
+                    accumulated.grow(buildInstances[begin + i].bounds);
+                    rightArea[i] = accumulated.surfaceArea();
+                }
+                accumulated = BoundingBox::empty();
+                for (unsigned i = 1; i < count; i++) {
+                    accumulated.grow(buildInstances[begin + i - 1].bounds);
+                    float cost = accumulated.surfaceArea() * (float) i + rightArea[i] * (float) (count - i);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        mid = begin + i;
+                    }
+                }
+            }
+        }
+        sortAlong(bestAxis);
+
+        nodes[nodeIndex].triangleCount = 0;
+        nodes[nodeIndex].splitAxis = bestAxis;
+        buildRecursive(begin, mid, currentDepth + 1);
+        unsigned secondChild = buildRecursive(mid, end, currentDepth + 1);
+        nodes[nodeIndex].secondChildOffset = secondChild;
+        return nodeIndex;
+    }
+}
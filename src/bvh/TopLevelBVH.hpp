@@ -0,0 +1,226 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "LinearBVH.hpp"
+#include "SphereBlocks.hpp"
+#include "../raytrace_objects/LightSource.hpp"
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+#include "../raytrace_objects/SphereRayTraceableObject.hpp"
+
+namespace RayTracing {
+    /// Object referenced by a leaf of the top level hierarchy
+    struct TopLevelInstance {
+        enum class Type : uint32_t {
+            MESH,
+            /// block of spheres and light sources tested together
+            SPHERES
+        };
+
+        Type type;
+        /// index into the meshes of the scene or into the sphere blocks of the hierarchy depending on the type
+        uint32_t index;
+    };
+
+    /**
+     * Top level bounding volume hierarchy over the world space bounds of all meshes, spheres and light sources of a
+     * scene. Meshes are intersected with their own bottom level hierarchy in local space, so the cost of finding the
+     * closest object grows logarithmically with the number of objects. Nodes with only a few spheres and light sources
+     * left become a single leaf whose objects are compiled into a SphereBlock.
+     */
+    class TopLevelBVH {
+    private:
+        /// Instance reference with precomputed world space bounds used during the build
+        struct BuildInstance {
+            BoundingBox bounds;
+            Vec3 centroid;
+            /// SPHERES instances reference a single sphere or light source of the scene during the build
+            TopLevelInstance instance;
+            bool light;
+            /// radius of a sphere or light source, its centroid is the center
+            float radius;
+        };
+
+        unsigned depth = 0;
+        /// number of meshes, spheres and light sources referenced by the leaves
+        unsigned objectCount = 0;
+        /// SAH cost right after the last build, refits are compared against it
+        float builtSAHCost = 0;
+        std::vector<BuildInstance> buildInstances;
+
+        /// Recursively build the node for buildInstances[begin, end), returns the index of the created node
+        unsigned buildRecursive(unsigned begin, unsigned end, unsigned currentDepth);
+
+    public:
+        std::vector<LinearBVHNode> nodes;
+        /// instances in leaf order, leaves reference contiguous ranges
+        std::vector<TopLevelInstance> instances;
+        /// spheres and light sources of the SPHERES instances
+        SphereBlocks sphereBlocks;
+
+        /**
+         * Calculate the world space bounds of a mesh object by mapping the corners of its local bounding box
+         * @param object object with updated bounding box and transform
+         * @return world space bounds
+         */
+        [[nodiscard]] static BoundingBox worldBounds(const MeshedRayTraceableObject &object);
+
+        /// Calculate the world space bounds of a sphere or light source
+        [[nodiscard]] static BoundingBox worldBounds(const SphereRayTraceableObject &sphere);
+
+        /**
+         * Build the hierarchy over all objects of a scene
+         * @param objects meshes with updated bounding boxes and transforms
+         * @param spheres spheres of the scene
+         * @param lights light sources of the scene
+         */
+        void build(const std::vector<MeshedRayTraceableObject *> &objects,
+                   const std::vector<SphereRayTraceableObject *> &spheres,
+                   const std::vector<LightSource *> &lights);
+
+        /**
+         * Update the node bounds bottom-up after objects moved, keeping the structure of the hierarchy.
+         * The hierarchy is rebuilt instead if the refit SAH cost exceeds the cost after the last build by more than
+         * rebuildThreshold, or if objects were added or lost their bounds.
+         * @param objects meshes with updated bounding boxes and transforms
+         * @param spheres spheres of the scene
+         * @param lights light sources of the scene
+         * @param rebuildThreshold allowed growth factor of the SAH cost
+         * @return true if the hierarchy was rebuilt
+         */
+        bool refit(const std::vector<MeshedRayTraceableObject *> &objects,
+                   const std::vector<SphereRayTraceableObject *> &spheres,
+                   const std::vector<LightSource *> &lights, float rebuildThreshold);
+
+        /**
+         * Visit all instances whose bounds are hit by a ray closer than maxDistance
+         * @param ray ray in world space
+         * @param maxDistance distance of the closest hit so far, re-read after every visit so visits can shorten it
+         * @param visitor called with every instance to test
+         * @param counters if not null, the ray, its node tests and visited instances are added to it
+         */
+        template<typename Visitor>
+        void traverse(const Ray &ray, const float &maxDistance, const Visitor &visitor,
+                      TraversalCounters *counters = nullptr) const {
+            if (counters != nullptr) {
+                counters->rays++;
+            }
+            if (instances.empty()) {
+                return;
+            }
+            unsigned stack[LINEAR_BVH_MAX_DEPTH];
+            unsigned stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0) {
+                unsigned nodeIndex = stack[--stackSize];
+                const LinearBVHNode &node = nodes[nodeIndex];
+                if (counters != nullptr) {
+                    counters->nodeTests++;
+                }
+                if (!ray.intersectsBoundingBox(node.bounds, maxDistance)) {
+                    continue;
+                }
+                if (node.isLeaf()) {
+                    if (counters != nullptr) {
+                        counters->primitiveTests += node.triangleCount;
+                    }
+                    for (unsigned i = node.trianglesOffset; i < node.trianglesOffset + node.triangleCount; i++) {
+                        visitor(instances[i]);
+                    }
+                } else if (ray.direction[node.splitAxis] < 0) {
+                    // nearer child first, so closer hits shorten maxDistance before the farther child is tested
+                    stack[stackSize++] = nodeIndex + 1;
+                    stack[stackSize++] = node.secondChildOffset;
+                } else {
+                    stack[stackSize++] = node.secondChildOffset;
+                    stack[stackSize++] = nodeIndex + 1;
+                }
+            }
+        }
+
+        /**
+         * Visit the instances whose bounds are hit by a ray closer than maxDistance until a visit reports a hit
+         * @param ray ray in world space
+         * @param maxDistance only bounds closer than this distance are visited
+         * @param visitor called with every instance to test, returns true to stop the traversal
+         * @param counters if not null, the ray, its node tests and visited instances are added to it
+         * @return true if a visit returned true
+         */
+        template<typename Visitor>
+        bool traverseUntil(const Ray &ray, float maxDistance, const Visitor &visitor,
+                           TraversalCounters *counters = nullptr) const {
+            if (counters != nullptr) {
+                counters->rays++;
+            }
+            if (instances.empty()) {
+                return false;
+            }
+            unsigned stack[LINEAR_BVH_MAX_DEPTH];
+            unsigned stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0) {
+                unsigned nodeIndex = stack[--stackSize];
+                const LinearBVHNode &node = nodes[nodeIndex];
+                if (counters != nullptr) {
+                    counters->nodeTests++;
+                }
+                if (!ray.intersectsBoundingBox(node.bounds, maxDistance)) {
+                    continue;
+                }
+                if (node.isLeaf()) {
+                    if (counters != nullptr) {
+                        counters->primitiveTests += node.triangleCount;
+                    }
+                    for (unsigned i = node.trianglesOffset; i < node.trianglesOffset + node.triangleCount; i++) {
+                        if (visitor(instances[i])) {
+                            return true;
+                        }
+                    }
+                } else {
+                    stack[stackSize++] = node.secondChildOffset;
+                    stack[stackSize++] = nodeIndex + 1;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Visit all instances whose bounds are hit by any of the selected rays of a packet closer than its closest hit
+         * @param packet rays in world space, the distances are re-read after every visit so visits can shorten them
+         * @param mask selected rays
+         * @param visitor called with every instance to test and the mask of the rays that hit its bounds
+         */
+        template<typename Visitor>
+        void traversePacket(const RayPacket &packet, uint64_t mask, const Visitor &visitor) const {
+            if (instances.empty() || mask == 0) {
+                return;
+            }
+            struct StackEntry {
+                uint32_t node;
+                uint64_t mask;
+            };
+            StackEntry stack[LINEAR_BVH_MAX_DEPTH + 1];
+            unsigned stackSize = 0;
+            stack[stackSize++] = {0, mask};
+            while (stackSize > 0) {
+                StackEntry entry = stack[--stackSize];
+                const LinearBVHNode &node = nodes[entry.node];
+                uint64_t hits = packet.intersectBox(node.bounds, entry.mask);
+                if (hits == 0) {
+                    continue;
+                }
+                if (node.isLeaf()) {
+                    for (unsigned i = node.trianglesOffset; i < node.trianglesOffset + node.triangleCount; i++) {
+                        visitor(instances[i], hits);
+                    }
+                } else {
+                    stack[stackSize++] = {node.secondChildOffset, hits};
+                    stack[stackSize++] = {entry.node + 1, hits};
+                }
+            }
+        }
+
+        /// Get the maximum depth of the hierarchy
+        [[nodiscard]] unsigned getDepth() const { return depth; }
+    };
+}
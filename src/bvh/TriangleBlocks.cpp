@@ -0,0 +1,213 @@
+#include "TriangleBlocks.hpp"
+
+#include <bit>
+#include <limits>
+
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    void TriangleBlocks::build(const Mesh &mesh, const LinearBVH &bvh) {
+        constexpr unsigned width = TRIANGLE_BLOCK_WIDTH;
+        blocks.clear();
+        leafBlocks.assign(mesh.numTriangles, 0);
+        // leaves are visited in depth first order, which is also the order of their triangles
+        for (const auto &node: bvh.nodes) {
+            if (!node.isLeaf()) {
+                continue;
+            }
+            leafBlocks[node.trianglesOffset] = blocks.size();
+            for (unsigned offset = 0; offset < node.triangleCount; offset += width) {
+                TriangleBlock<width> &block = blocks.emplace_back();
+                for (unsigned lane = 0; lane < width && offset + lane < node.triangleCount; lane++) {
+                    const int *triangle = &mesh.indices[(node.trianglesOffset + offset + lane) * 3];
+                    const Vec3 &a = mesh.vertices[triangle[0]];
+                    Vec3 edgeAB = mesh.vertices[triangle[1]] - a;
+                    Vec3 edgeAC = mesh.vertices[triangle[2]] - a;
+                    Vec3 normal = Vec3::cross(edgeAB, edgeAC);
+                    for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                        block.vertex[axis][lane] = a[axis];
+                        block.edgeAB[axis][lane] = edgeAB[axis];
+                        block.edgeAC[axis][lane] = edgeAC[axis];
+                        block.normal[axis][lane] = normal[axis];
+                    }
+                }
+            }
+        }
+    }
+
+    void TriangleBlocks::clear() {
+        blocks.clear();
+        blocks.shrink_to_fit();
+        leafBlocks.clear();
+        leafBlocks.shrink_to_fit();
+    }
+
+    /**
+     * Möller-Trumbore test of the triangles and rays in the lanes, with the operations of LocalRay::intersectTriangle
+     * in the same order, so all kernels find the same hits at the same distances as the scalar test.
+     * Either the triangles or the rays can be broadcast.
+     * @param distance set to the distance along the ray of every lane
+     * @return mask of the lanes that are hit closer than maxDistance
+     */
+    template<typename Lanes>
+    static unsigned intersectLanes(const Lanes origin[3], const Lanes direction[3], const Lanes vertex[3],
+                                   const Lanes edgeAB[3], const Lanes edgeAC[3], const Lanes normal[3],
+                                   const Lanes &maxDistance, Lanes &distance) {
+        const Lanes zero = Lanes::broadcast(0);
+        const Lanes one = Lanes::broadcast(1);
+        const Lanes epsilon = Lanes::broadcast(std::numeric_limits<float>::epsilon());
+        Lanes ao[3] = {origin[0] - vertex[0], origin[1] - vertex[1], origin[2] - vertex[2]};
+        Lanes dao[3] = {
+            ao[1] * direction[2] - ao[2] * direction[1],
+            ao[2] * direction[0] - ao[0] * direction[2],
+            ao[0] * direction[1] - ao[1] * direction[0]
+        };
+
+        Lanes det = zero - (direction[0] * normal[0] + direction[1] * normal[1] + direction[2] * normal[2]);
+        Lanes invDet = one / det;
+        distance = (ao[0] * normal[0] + ao[1] * normal[1] + ao[2] * normal[2]) * invDet;
+        Lanes u = (edgeAC[0] * dao[0] + edgeAC[1] * dao[1] + edgeAC[2] * dao[2]) * invDet;
+        Lanes v = (zero - (edgeAB[0] * dao[0] + edgeAB[1] * dao[1] + edgeAB[2] * dao[2])) * invDet;
+        Lanes w = one - u - v;
+
+        return Lanes::lessMask(epsilon, det) & Lanes::lessEqualMask(epsilon, distance) &
+               Lanes::lessEqualMask(zero, u) & Lanes::lessEqualMask(zero, v) & Lanes::lessEqualMask(zero, w) &
+               Lanes::lessMask(distance, maxDistance);
+    }
+
+    /// Load the precomputed triangle data of a block into lanes
+    template<typename Lanes, unsigned Width>
+    static void loadBlock(const TriangleBlock<Width> &block, Lanes vertex[3], Lanes edgeAB[3], Lanes edgeAC[3],
+                          Lanes normal[3]) {
+        for (unsigned axis = 0; axis < 3; axis++) {
+            vertex[axis] = Lanes::load(block.vertex[axis]);
+            edgeAB[axis] = Lanes::load(block.edgeAB[axis]);
+            edgeAC[axis] = Lanes::load(block.edgeAC[axis]);
+            normal[axis] = Lanes::load(block.normal[axis]);
+        }
+    }
+
+    void TriangleBlocks::intersect(const LocalRay &ray, const Mesh &mesh, unsigned first, unsigned count,
+                                   HitInfo &closest) const {
+        constexpr unsigned width = TRIANGLE_BLOCK_WIDTH;
+        using Lanes = FloatLanes<width>::Type;
+        const Lanes origin[3] = {
+            Lanes::broadcast(ray.origin[Vec3::X_AXIS]), Lanes::broadcast(ray.origin[Vec3::Y_AXIS]),
+            Lanes::broadcast(ray.origin[Vec3::Z_AXIS])
+        };
+        const Lanes direction[3] = {
+            Lanes::broadcast(ray.direction[Vec3::X_AXIS]), Lanes::broadcast(ray.direction[Vec3::Y_AXIS]),
+            Lanes::broadcast(ray.direction[Vec3::Z_AXIS])
+        };
+        Lanes closestDistance = Lanes::broadcast(closest.distance);
+
+        unsigned blockIndex = leafBlocks[first];
+        for (unsigned offset = 0; offset < count; offset += width, blockIndex++) {
+            Lanes vertex[3];
+            Lanes edgeAB[3];
+            Lanes edgeAC[3];
+            Lanes normal[3];
+            loadBlock(blocks[blockIndex], vertex, edgeAB, edgeAC, normal);
+            Lanes distance;
+            unsigned mask = intersectLanes(origin, direction, vertex, edgeAB, edgeAC, normal, closestDistance,
+                                           distance);
+            if (mask == 0) {
+                continue;
+            }
+
+            // the closest hit lane, the first one if several are equally close
+            float distances[width];
+            distance.store(distances);
+            unsigned best = std::countr_zero(mask);
+            for (mask &= mask - 1; mask != 0; mask &= mask - 1) {
+                unsigned lane = std::countr_zero(mask);
+                if (distances[lane] < distances[best]) {
+                    best = lane;
+                }
+            }
+            closest = {
+                .hit = true,
+                .hitPoint = ray.origin + (ray.direction * distances[best]),
+                .normal = mesh.normals[first + offset + best],
+                .distance = distances[best]
+            };
+            closestDistance = Lanes::broadcast(distances[best]);
+        }
+    }
+
+    bool TriangleBlocks::occluded(const LocalRay &ray, unsigned first, unsigned count, float maxDistance) const {
+        constexpr unsigned width = TRIANGLE_BLOCK_WIDTH;
+        using Lanes = FloatLanes<width>::Type;
+        const Lanes origin[3] = {
+            Lanes::broadcast(ray.origin[Vec3::X_AXIS]), Lanes::broadcast(ray.origin[Vec3::Y_AXIS]),
+            Lanes::broadcast(ray.origin[Vec3::Z_AXIS])
+        };
+        const Lanes direction[3] = {
+            Lanes::broadcast(ray.direction[Vec3::X_AXIS]), Lanes::broadcast(ray.direction[Vec3::Y_AXIS]),
+            Lanes::broadcast(ray.direction[Vec3::Z_AXIS])
+        };
+        const Lanes distanceLimit = Lanes::broadcast(maxDistance);
+
+        unsigned blockIndex = leafBlocks[first];
+        for (unsigned offset = 0; offset < count; offset += width, blockIndex++) {
+            Lanes vertex[3];
+            Lanes edgeAB[3];
+            Lanes edgeAC[3];
+            Lanes normal[3];
+            loadBlock(blocks[blockIndex], vertex, edgeAB, edgeAC, normal);
+            Lanes distance;
+            if (intersectLanes(origin, direction, vertex, edgeAB, edgeAC, normal, distanceLimit, distance) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TriangleBlocks::intersectPacket(RayPacket &packet, uint64_t mask, unsigned first, unsigned count) const {
+        // the triangle is broadcast and the rays are in the lanes
+        using Lanes = FloatLanes<RAY_PACKET_LANES>::Type;
+        constexpr uint64_t laneMask = (1ull << RAY_PACKET_LANES) - 1;
+
+        for (unsigned triangle = 0; triangle < count; triangle++) {
+            const TriangleBlock<TRIANGLE_BLOCK_WIDTH> &block =
+                    blocks[leafBlocks[first] + triangle / TRIANGLE_BLOCK_WIDTH];
+            const unsigned lane = triangle % TRIANGLE_BLOCK_WIDTH;
+            Lanes vertex[3];
+            Lanes edgeAB[3];
+            Lanes edgeAC[3];
+            Lanes normal[3];
+            for (unsigned axis = 0; axis < 3; axis++) {
+                vertex[axis] = Lanes::broadcast(block.vertex[axis][lane]);
+                edgeAB[axis] = Lanes::broadcast(block.edgeAB[axis][lane]);
+                edgeAC[axis] = Lanes::broadcast(block.edgeAC[axis][lane]);
+                normal[axis] = Lanes::broadcast(block.normal[axis][lane]);
+            }
+
+            for (unsigned firstRay = 0; firstRay < packet.size; firstRay += RAY_PACKET_LANES) {
+                if (((mask >> firstRay) & laneMask) == 0) {
+                    continue;
+                }
+                Lanes origin[3];
+                Lanes direction[3];
+                for (unsigned axis = 0; axis < 3; axis++) {
+                    origin[axis] = Lanes::load(&packet.origin[axis][firstRay]);
+                    direction[axis] = Lanes::load(&packet.direction[axis][firstRay]);
+                }
+                Lanes distance;
+                uint64_t hits = intersectLanes(origin, direction, vertex, edgeAB, edgeAC, normal,
+                                               Lanes::load(&packet.maxDistance[firstRay]), distance);
+                hits &= mask >> firstRay;
+                if (hits == 0) {
+                    continue;
+                }
+                float distances[RAY_PACKET_LANES];
+                distance.store(distances);
+                for (; hits != 0; hits &= hits - 1) {
+                    unsigned ray = std::countr_zero(hits);
+                    packet.maxDistance[firstRay + ray] = distances[ray];
+                    packet.primitive[firstRay + ray] = first + triangle;
+                }
+            }
+        }
+    }
+}
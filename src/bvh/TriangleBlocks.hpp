@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "LinearBVH.hpp"
+#include "../RayPacket.hpp"
+#include "../math/simd.hpp"
+
+namespace RayTracing {
+#if defined(RAYTRACER_SIMD_AVX) || defined(RAYTRACER_SIMD_NEON)
+    /// number of triangles tested at once, one AVX register or a pair of NEON registers
+    constexpr unsigned TRIANGLE_BLOCK_WIDTH = 8;
+#else
+    /// number of triangles tested at once, one SSE register
+    constexpr unsigned TRIANGLE_BLOCK_WIDTH = 4;
+#endif
+
+    /**
+     * Precomputed data of up to Width triangles, stored as structure of arrays per coordinate.
+     * Unused lanes are all zero, their determinant is 0 and they are never hit.
+     */
+    template<unsigned Width>
+    struct alignas(32) TriangleBlock {
+        /// first vertex of every triangle
+        float vertex[3][Width];
+        /// edges from the first to the second and to the third vertex
+        float edgeAB[3][Width];
+        float edgeAC[3][Width];
+        /// unnormalized geometric normal, the cross product of both edges
+        float normal[3][Width];
+    };
+
+    /**
+     * Triangles of a mesh compiled into blocks for the SIMD triangle test.
+     * Every leaf of the hierarchy gets its own blocks, so a leaf is intersected by testing whole blocks without
+     * gathering vertices through the index array. Has to be rebuilt whenever the vertices or the leaves change.
+     */
+    class TriangleBlocks {
+    private:
+        std::vector<TriangleBlock<TRIANGLE_BLOCK_WIDTH> > blocks;
+        /// index of the first block of every leaf, by the index of the first triangle of the leaf
+        std::vector<uint32_t> leafBlocks;
+
+    public:
+        /**
+         * Compile the triangles of all leaves of a hierarchy into blocks
+         * @param mesh mesh with its triangles in leaf order
+         * @param bvh hierarchy of the mesh
+         */
+        void build(const Mesh &mesh, const LinearBVH &bvh);
+
+        /// Release all blocks, until the next build leaves are intersected triangle by triangle
+        void clear();
+
+        [[nodiscard]] bool empty() const { return blocks.empty(); }
+
+        /**
+         * Intersect a ray with all triangles of a leaf, testing a whole block with one SIMD pass
+         * @param ray ray in local object space
+         * @param mesh mesh the blocks were built for, provides the shading normal of the hit triangle
+         * @param first index of the first triangle of the leaf
+         * @param count number of triangles in the leaf
+         * @param closest closest hit so far, updated if a closer triangle is hit
+         */
+        void intersect(const LocalRay &ray, const Mesh &mesh, unsigned first, unsigned count, HitInfo &closest) const;
+
+        /**
+         * Check if a ray hits any triangle of a leaf closer than maxDistance, stops at the first block with a hit
+         * @param ray ray in local object space
+         * @param first index of the first triangle of the leaf
+         * @param count number of triangles in the leaf
+         * @param maxDistance only hits closer than this distance count
+         * @return true if a triangle is hit
+         */
+        [[nodiscard]] bool occluded(const LocalRay &ray, unsigned first, unsigned count, float maxDistance) const;
+
+        /**
+         * Intersect the selected rays of a packet with all triangles of a leaf, testing one triangle against the rays
+         * of a SIMD register at a time
+         * @param packet rays in local object space, the distance and primitive of rays hitting a closer triangle are
+         * updated
+         * @param mask selected rays
+         * @param first index of the first triangle of the leaf
+         * @param count number of triangles in the leaf
+         */
+        void intersectPacket(RayPacket &packet, uint64_t mask, unsigned first, unsigned count) const;
+
+        /// Get the memory used by the blocks in bytes
+        [[nodiscard]] size_t memoryUsage() const {
+            return blocks.size() * sizeof(TriangleBlock<TRIANGLE_BLOCK_WIDTH>) + leafBlocks.size() * sizeof(uint32_t);
+        }
+    };
+}
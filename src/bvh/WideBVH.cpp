@@ -0,0 +1,101 @@
+#include "WideBVH.hpp"
+
+#include <cmath>
+
+#include "WideBVHTraversal.hpp"
+#include "../raytrace_objects/MeshedRayTraceableObject.hpp"
+
+namespace RayTracing {
+    template<unsigned Width>
+    WideBVH<Width>::WideBVH(const LinearBVH &bvh) {
+        // hierarchies of empty meshes, possibly loaded from an older cache as a single node without triangles
+        if (bvh.nodes.empty() || bvh.triangleCount() == 0) {
+            return;
+        }
+        nodes.reserve(bvh.nodes.size() / 2 + 1);
+        collapseRecursive(bvh, 0);
+    }
+
+    template<unsigned Width>
+    unsigned WideBVH<Width>::collapseRecursive(const LinearBVH &bvh, unsigned binaryNode) {
+        // collect the children by repeatedly replacing the inner child with the largest surface area by its children
+        unsigned children[Width];
+        unsigned childCount = 0;
+        const LinearBVHNode &node = bvh.nodes[binaryNode];
+        if (node.isLeaf()) {
+            children[childCount++] = binaryNode; // single leaf hierarchy
+        } else {
+            children[childCount++] = binaryNode + 1;
+            children[childCount++] = node.secondChildOffset;
+        }
+        while (childCount < Width) {
+            int largest = -1;
+            float largestArea = -1;
+            for (unsigned i = 0; i < childCount; i++) {
+                const LinearBVHNode &child = bvh.nodes[children[i]];
+                if (!child.isLeaf() && child.bounds.surfaceArea() > largestArea) {
+                    largest = (int) i;
+                    largestArea = child.bounds.surfaceArea();
+                }
+            }
+            if (largest < 0) {
+                break; // only leaves left
+            }
+            unsigned opened = children[largest];
+            children[largest] = opened + 1;
+            children[childCount++] = bvh.nodes[opened].secondChildOffset;
+        }
+
+        unsigned nodeIndex = nodes.size();
+        nodes.emplace_back();
+        for (unsigned i = 0; i < Width; i++) {
+            for (unsigned axis = 0; axis < 3; axis++) {
+                nodes[nodeIndex].bounds[axis * 2][i] = INFINITY;
+                nodes[nodeIndex].bounds[axis * 2 + 1][i] = -INFINITY;
+            }
+            nodes[nodeIndex].child[i] = 0;
+            nodes[nodeIndex].triangleCount[i] = 0;
+        }
+
+        for (unsigned i = 0; i < childCount; i++) {
+            const LinearBVHNode &child = bvh.nodes[children[i]];
+            for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                nodes[nodeIndex].bounds[axis * 2][i] = child.bounds.minPos[axis];
+                nodes[nodeIndex].bounds[axis * 2 + 1][i] = child.bounds.maxPos[axis];
+            }
+            if (child.isLeaf()) {
+                nodes[nodeIndex].child[i] = child.trianglesOffset;
+                nodes[nodeIndex].triangleCount[i] = child.triangleCount;
+            } else {
+                unsigned childIndex = collapseRecursive(bvh, children[i]);
+                nodes[nodeIndex].child[i] = childIndex;
+            }
+        }
+        return nodeIndex;
+    }
+
+    namespace {
+        /// Load the exact positions of a plane of all children of a node
+        template<unsigned Width>
+        struct ExactPlanes {
+            typename FloatLanes<Width>::Type operator()(const WideBVHNode<Width> &node, unsigned plane,
+                                                        unsigned) const {
+                return FloatLanes<Width>::Type::load(node.bounds[plane]);
+            }
+        };
+    }
+
+    template<unsigned Width>
+    HitInfo WideBVH<Width>::intersect(const LocalRay &ray, const Mesh &mesh, TraversalCounters *counters) const {
+        return WideBVHTraversal<Width>(ray).intersect(nodes, mesh, ExactPlanes<Width>(), counters);
+    }
+
+    template<unsigned Width>
+    bool WideBVH<Width>::occluded(const LocalRay &ray, const Mesh &mesh, float maxDistance,
+                                  TraversalCounters *counters) const {
+        return WideBVHTraversal<Width>(ray).occluded(nodes, mesh, maxDistance, ExactPlanes<Width>(), counters);
+    }
+
+    template class WideBVH<4>;
+    template class WideBVH<8>;
+}
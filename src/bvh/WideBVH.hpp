@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "LinearBVH.hpp"
+
+namespace RayTracing {
+    /**
+     * Node of a wide bounding volume hierarchy with up to Width children.
+     * The bounds of all children are stored as structure of arrays, so a ray is tested against all of them at once.
+     * Unused child slots have inverted infinite bounds and are never hit.
+     */
+    template<unsigned Width>
+    struct alignas(32) WideBVHNode {
+        /// child bounds per plane: min x, max x, min y, max y, min z, max z
+        float bounds[6][Width];
+        /// inner child: index of the child node, leaf child: index of its first triangle
+        uint32_t child[Width];
+        /// number of triangles of a leaf child, 0 for inner children and unused slots
+        uint32_t triangleCount[Width];
+    };
+
+    /**
+     * Bounding volume hierarchy with 4 or 8 children per node, collapsed from a binary LinearBVH.
+     * Leaves keep referencing the triangle ranges of the binary hierarchy in the reordered mesh. The box tests of all
+     * children of a node are done in one SIMD pass and children are visited from near to far.
+     */
+    template<unsigned Width>
+    class WideBVH {
+    private:
+        /// Create the node for the binary inner node and its collapsed descendants, returns the created node index
+        unsigned collapseRecursive(const LinearBVH &bvh, unsigned binaryNode);
+
+    public:
+        std::vector<WideBVHNode<Width> > nodes;
+
+        /**
+         * Collapse a binary hierarchy into a wide one
+         * @param bvh binary hierarchy
+         */
+        explicit WideBVH(const LinearBVH &bvh);
+
+        /**
+         * Find the closest intersection of a ray with the triangles of the mesh
+         * @param ray ray in local object space
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return closest intersection in local object space
+         */
+        [[nodiscard]] HitInfo intersect(const LocalRay &ray, const Mesh &mesh,
+                                        TraversalCounters *counters = nullptr) const;
+
+        /**
+         * Check if a ray hits any triangle of the mesh closer than maxDistance. The leaf children of a node are tested
+         * before any inner child is descended into and traversal stops at the first hit.
+         * @param ray ray in local object space
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param maxDistance only hits closer than this distance count
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return true if a triangle is hit
+         */
+        [[nodiscard]] bool occluded(const LocalRay &ray, const Mesh &mesh, float maxDistance,
+                                    TraversalCounters *counters = nullptr) const;
+
+        /// Get the memory used by the nodes in bytes
+        [[nodiscard]] size_t memoryUsage() const { return nodes.size() * sizeof(WideBVHNode<Width>); }
+    };
+}
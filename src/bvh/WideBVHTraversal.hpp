@@ -0,0 +1,193 @@
+#pragma once
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "LinearBVH.hpp"
+#include "../math/simd.hpp"
+
+namespace RayTracing {
+    /**
+     * Traversal of a single ray shared by all wide hierarchy layouts.
+     * A layout only provides a functor loading the positions of one plane of all children of a node, called as
+     * loadPlane(node, plane, axis) and returning the positions as lanes. The box tests, the near to far order of the
+     * children and the stack handling are the same for all layouts.
+     */
+    template<unsigned Width>
+    class WideBVHTraversal {
+    public:
+        using Lanes = typename FloatLanes<Width>::Type;
+
+    private:
+        /// Entry of the closest hit traversal stack
+        struct StackEntry {
+            uint32_t child;
+            uint32_t triangleCount;
+            float distance;
+        };
+
+        /// most entries on the stack, every node replaces itself by at most all of its children
+        static constexpr unsigned STACK_SIZE = LINEAR_BVH_MAX_DEPTH * (Width - 1) + 1;
+
+        const LocalRay &ray;
+        Lanes origin[3];
+        Lanes inverseDirection[3];
+        /// near and far plane of every axis, swapped for negative directions
+        unsigned nearPlane[3];
+        unsigned farPlane[3];
+
+        /**
+         * Test the ray against the boxes of all children of a node
+         * @param node node of the layout
+         * @param loadPlane functor loading the positions of a plane of all children
+         * @param maxDistance children further away than this are missed
+         * @param tNear set to the distance at which the ray enters each child
+         * @return bit mask of the hit children
+         */
+        template<typename Node, typename LoadPlane>
+        unsigned testChildren(const Node &node, const LoadPlane &loadPlane, float maxDistance, Lanes &tNear) const {
+            auto planeDistance = [&](unsigned plane, unsigned axis) {
+                return (loadPlane(node, plane, axis) - origin[axis]) * inverseDirection[axis];
+            };
+            Lanes nearX = planeDistance(nearPlane[0], 0);
+            Lanes nearY = planeDistance(nearPlane[1], 1);
+            Lanes nearZ = planeDistance(nearPlane[2], 2);
+            Lanes farX = planeDistance(farPlane[0], 0);
+            Lanes farY = planeDistance(farPlane[1], 1);
+            Lanes farZ = planeDistance(farPlane[2], 2);
+            tNear = Lanes::max(Lanes::max(nearX, nearY), Lanes::max(nearZ, Lanes::broadcast(0)));
+            Lanes tFar = Lanes::min(Lanes::min(farX, farY), Lanes::min(farZ, Lanes::broadcast(maxDistance)));
+            return Lanes::lessEqualMask(tNear, tFar);
+        }
+
+    public:
+        /// Prepare the per ray constants of the box tests
+        explicit WideBVHTraversal(const LocalRay &ray) : ray(ray) {
+            for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                float inverse = 1.0f / ray.direction[axis];
+                origin[axis] = Lanes::broadcast(ray.origin[axis]);
+                inverseDirection[axis] = Lanes::broadcast(inverse);
+                nearPlane[axis] = axis * 2 + (std::signbit(inverse) ? 1 : 0);
+                farPlane[axis] = axis * 2 + (std::signbit(inverse) ? 0 : 1);
+            }
+        }
+
+        /**
+         * Find the closest intersection of the ray with the triangles of the mesh, children are visited from near to
+         * far
+         * @param nodes nodes of the hierarchy, the first one is the root
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param loadPlane functor loading the positions of a plane of all children of a node
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return closest intersection in local object space
+         */
+        template<typename Node, typename LoadPlane>
+        HitInfo intersect(const std::vector<Node> &nodes, const Mesh &mesh, const LoadPlane &loadPlane,
+                          TraversalCounters *counters) const {
+            HitInfo closest{.hit = false, .distance = INFINITY};
+            if (nodes.empty()) {
+                return closest;
+            }
+
+            StackEntry stack[STACK_SIZE];
+            unsigned stackSize = 0;
+            stack[stackSize++] = {0, 0, 0};
+            while (stackSize > 0) {
+                StackEntry entry = stack[--stackSize];
+                if (entry.distance >= closest.distance) {
+                    continue; // a closer triangle was hit after this entry was pushed
+                }
+                if (entry.triangleCount > 0) {
+                    if (counters != nullptr) {
+                        counters->primitiveTests += entry.triangleCount;
+                    }
+                    LinearBVH::intersectTriangles(ray, mesh, entry.child, entry.triangleCount, closest);
+                    continue;
+                }
+
+                const Node &node = nodes[entry.child];
+                if (counters != nullptr) {
+                    counters->nodeTests++;
+                }
+                Lanes tNear;
+                unsigned mask = testChildren(node, loadPlane, closest.distance, tNear);
+                if (mask == 0) {
+                    continue;
+                }
+
+                // sort the hit children from far to near and push them, so the nearest one is popped first
+                float distances[Width];
+                tNear.store(distances);
+                unsigned hits[Width];
+                unsigned hitCount = 0;
+                for (unsigned i = 0; i < Width; i++) {
+                    if ((mask >> i) & 1) {
+                        unsigned position = hitCount++;
+                        while (position > 0 && distances[hits[position - 1]] < distances[i]) {
+                            hits[position] = hits[position - 1];
+                            position--;
+                        }
+                        hits[position] = i;
+                    }
+                }
+                for (unsigned i = 0; i < hitCount; i++) {
+                    stack[stackSize++] = {node.child[hits[i]], node.triangleCount[hits[i]], distances[hits[i]]};
+                }
+            }
+            return closest;
+        }
+
+        /**
+         * Check if the ray hits any triangle of the mesh closer than maxDistance. The leaf children of a node are
+         * tested before any inner child is descended into and traversal stops at the first hit.
+         * @param nodes nodes of the hierarchy, the first one is the root
+         * @param mesh mesh the hierarchy was built for, with its triangles in leaf order
+         * @param maxDistance only hits closer than this distance count
+         * @param loadPlane functor loading the positions of a plane of all children of a node
+         * @param counters if not null, the node and triangle tests are added to it
+         * @return true if a triangle is hit
+         */
+        template<typename Node, typename LoadPlane>
+        bool occluded(const std::vector<Node> &nodes, const Mesh &mesh, float maxDistance, const LoadPlane &loadPlane,
+                      TraversalCounters *counters) const {
+            if (nodes.empty()) {
+                return false;
+            }
+
+            // only inner nodes are pushed, the root is never a leaf
+            uint32_t stack[STACK_SIZE];
+            unsigned stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0) {
+                const Node &node = nodes[stack[--stackSize]];
+                if (counters != nullptr) {
+                    counters->nodeTests++;
+                }
+                Lanes tNear;
+                unsigned mask = testChildren(node, loadPlane, maxDistance, tNear);
+
+                // leaves first, a hit in them ends the traversal before any subtree is descended into
+                for (unsigned hits = mask; hits != 0; hits &= hits - 1) {
+                    unsigned i = std::countr_zero(hits);
+                    if (node.triangleCount[i] == 0) {
+                        continue;
+                    }
+                    if (counters != nullptr) {
+                        counters->primitiveTests += node.triangleCount[i];
+                    }
+                    if (LinearBVH::occludedTriangles(ray, mesh, node.child[i], node.triangleCount[i], maxDistance)) {
+                        return true;
+                    }
+                }
+                for (unsigned hits = mask; hits != 0; hits &= hits - 1) {
+                    unsigned i = std::countr_zero(hits);
+                    if (node.triangleCount[i] == 0) {
+                        stack[stackSize++] = node.child[i];
+                    }
+                }
+            }
+            return false;
+        }
+    };
+}
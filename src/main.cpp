@@ -1,8 +1,10 @@
 #include <iostream>
+#include <omp.h>
 
 #include "RayTracer.hpp"
 #include "Renderer.h"
 #include "raytracers/RayTracerFactory.hpp"
+#include "raytracers/SequentialRayTracer.hpp"
 #include "argumentsResolver.hpp"
 #include "timing.hpp"
 
@@ -18,6 +20,15 @@ std::string benchmarkFile = "../timeLog.csv";
 unsigned bounces = 10;
 unsigned samples = 20;
 Vec2u windowSize = RayTracing::Vec2u(1920, 1440);
+BVHBuildSettings bvhBuildSettings{};
+RenderSettings renderSettings{};
+bool bvhBuildBenchmark = false;
+bool bvhLayoutBenchmark = false;
+bool renderSequence = false;
+bool bvhStatistics = false;
+bool progressive = false;
+float adaptiveError = 0;
+std::string sampleCountFile;
 // auto windowSize = Vec2u(400, 300);
 
 /**
@@ -26,9 +37,11 @@ Vec2u windowSize = RayTracing::Vec2u(1920, 1440);
  * @param scene the scene to raytrace
  * @param deleteImg whether to delete the resulting image after benchmarking
  * @param deleteTracer whether to delete the raytracer after benchmarking
+ * @param frame frame of the scene animation that is rendered
  * @return the resulting image if deleteImg is false, nullptr otherwise
  */
-Image *benchmarkRaytracer(RayTracer *raytracer, const Scene &scene, bool deleteImg = true, bool deleteTracer = true) {
+Image *benchmarkRaytracer(RayTracer *raytracer, const Scene &scene, bool deleteImg = true, bool deleteTracer = true,
+                          unsigned frame = 0) {
     TIMING_START(raytrace)
     Image *raytraced = raytracer->raytrace(scene);
     TIMING_END(raytrace)
@@ -44,7 +57,8 @@ Image *benchmarkRaytracer(RayTracer *raytracer, const Scene &scene, bool deleteI
                 "Width,Height," <<
                 "Triangles,Spheres," <<
                 "Scene Loading(ms),Encoding(ms),Raytracing(ms),Decoding(ms),Total Duration (ms)," <<
-                "Git Hash"
+                "Git Hash," <<
+                "BVH Builder,BVH Build(ms),BVH SAH Cost,BVH Layout,Frame,BVH Cache Hits,Ray Packet Size"
                 <<
                 std::endl;
     }
@@ -58,8 +72,10 @@ Image *benchmarkRaytracer(RayTracer *raytracer, const Scene &scene, bool deleteI
             TIMING_GET_DURATION(raytracer, RaytracingTimer::Component::RAYTRACING) << "," <<
             TIMING_GET_DURATION(raytracer, RaytracingTimer::Component::DECODING) << "," <<
             TIMING_GET_DURATION(raytracer, RaytracingTimer::Component::TOTAL_RAYTRACING) << "," <<
-            GIT_COMMIT_HASH
-            << std::endl;
+            GIT_COMMIT_HASH << "," <<
+            BVHBuildSettings::builderName(scene.bvhBuildSettings.builder) << "," << scene.getBVHBuildMillis() << "," <<
+            scene.getBVHSAHCost() << "," << BVHBuildSettings::layoutName(scene.bvhBuildSettings.layout) << "," <<
+            frame << "," << scene.getBVHCacheHits() << "," << raytracer->getRenderSettings().rayPacketSize << std::endl;
     timeLog.close();
 
     if (deleteTracer) {
@@ -72,6 +88,257 @@ Image *benchmarkRaytracer(RayTracer *raytracer, const Scene &scene, bool deleteI
     return raytraced;
 }
 
+/**
+ * Build the bounding volume hierarchies of all meshes in the scene with an increasing number of threads and print the
+ * build time and speedup per thread count. Every build is checked against the single threaded hierarchy.
+ * @param scene the scene containing the meshes
+ * @param settings build settings, the thread count is overwritten
+ */
+void benchmarkBVHBuild(const Scene &scene, BVHBuildSettings settings) {
+    const unsigned maxThreads = omp_get_max_threads();
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    // instances share the mesh of their owner, every mesh is built once
+    std::vector<Mesh *> meshes;
+    unsigned triangleCount = 0;
+    for (const auto object: scene.objects) {
+        if (object->instanceOf == nullptr) {
+            meshes.push_back(object->mesh);
+            triangleCount += object->mesh->fileTriangleCount;
+        }
+    }
+    std::cout << "[BVHBuildBenchmark] Building " << meshes.size() << " meshes (" << triangleCount
+            << " triangles) with the " << BVHBuildSettings::builderName(settings.builder) << " builder" << std::endl;
+
+    std::vector<NestedBoundingBox *> reference;
+    std::vector<std::vector<unsigned> > referenceOrder;
+    double serialMillis = 0;
+    for (unsigned threads: threadCounts) {
+        settings.buildThreads = threads;
+        BVHBuilder *builder = BVHBuilder::create(settings);
+        double millis = 0;
+        bool identical = true;
+        for (unsigned meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            std::vector<unsigned> triangleOrder;
+            NestedBoundingBox *root = builder->build(*meshes[meshIndex], triangleOrder);
+            millis += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).
+                    count();
+            if (threads == 1) {
+                reference.push_back(root);
+                referenceOrder.push_back(std::move(triangleOrder));
+            } else {
+                identical &= root->treeEquals(*reference[meshIndex]) &&
+                        triangleOrder == referenceOrder[meshIndex];
+                delete root;
+            }
+        }
+        delete builder;
+        if (threads == 1) {
+            serialMillis = millis;
+            float sahCost = 0;
+            for (auto root: reference) {
+                sahCost += LinearBVH(root).sahCost(settings.traversalCost, settings.intersectionCost);
+            }
+            std::cout << "[BVHBuildBenchmark] SAH cost: " << sahCost << std::endl;
+        }
+        std::cout << "[BVHBuildBenchmark] " << threads << " threads: " << millis << " ms, speedup " <<
+                serialMillis / millis << "x" << (identical ? "" : ", hierarchy differs from single threaded build")
+                << std::endl;
+    }
+    for (auto root: reference) {
+        delete root;
+    }
+}
+
+/**
+ * Render the prepared scene once with every node layout and compare the memory of the hierarchies and the camera ray
+ * throughput of the compressed layouts against the uncompressed ones
+ * @param raytracer the raytracer implementation to render with
+ * @param scene prepared scene, its meshes are left in the last benchmarked layout
+ */
+void benchmarkBVHLayouts(RayTracer *raytracer, Scene &scene) {
+    const BVHLayout layouts[] = {
+        BVHLayout::BINARY, BVHLayout::BVH4, BVHLayout::BVH4_Q16, BVHLayout::BVH4_Q8, BVHLayout::BVH8,
+        BVHLayout::BVH8_Q16, BVHLayout::BVH8_Q8
+    };
+    std::cout << "[BVHLayoutBenchmark] Rendering " << raytracer->getRayCount() << " camera rays per layout" <<
+            std::endl;
+    size_t uncompressedMemory = 0;
+    double uncompressedRaysPerSecond = 0;
+    for (BVHLayout layout: layouts) {
+        scene.bvhBuildSettings.layout = layout;
+        size_t memory = 0;
+        for (auto &object: scene.objects) {
+            object->updateWideBVH(layout);
+            memory += object->hierarchyMemoryUsage();
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        Image *image = raytracer->raytrace(scene);
+        double millis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).
+                count();
+        delete image;
+
+        double raysPerSecond = raytracer->getRayCount() / (millis / 1000);
+        if (layout == BVHLayout::BVH4 || layout == BVHLayout::BVH8) {
+            uncompressedMemory = memory;
+            uncompressedRaysPerSecond = raysPerSecond;
+        }
+        std::cout << "[BVHLayoutBenchmark] " << BVHBuildSettings::layoutName(layout) << ": " << memory / 1024 <<
+                " KiB, " << millis << " ms, " << raysPerSecond / 1e6 << " M camera rays/s";
+        if (layout != BVHLayout::BINARY && layout != BVHLayout::BVH4 && layout != BVHLayout::BVH8) {
+            std::cout << " (" << 100.0 * memory / uncompressedMemory << "% memory, " << 100.0 * raysPerSecond /
+                    uncompressedRaysPerSecond << "% throughput of the uncompressed layout)";
+        }
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * Insert the frame number before the extension of a file name, e.g. raytraced.jpg becomes raytraced_0007.jpg
+ * @param file file name of a single image
+ * @param frame frame number
+ * @return file name of the frame
+ */
+std::string sequenceFileName(const std::string &file, unsigned frame) {
+    std::string number = std::to_string(frame);
+    number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+    size_t extension = file.find_last_of('.');
+    size_t directory = file.find_last_of('/');
+    if (extension == std::string::npos || (directory != std::string::npos && directory > extension)) {
+        return file + "_" + number;
+    }
+    return file.substr(0, extension) + "_" + number + file.substr(extension);
+}
+
+/**
+ * Render every frame of the scene animation in this process. Meshes stay loaded and the hierarchies are refit between
+ * frames, every frame is timed and logged to the benchmark file separately.
+ * @param raytracer the raytracer implementation to render with
+ * @param scene prepared scene, left at the last frame
+ * @param imageHandler image handler used to save the frames
+ * @return image of the last frame
+ */
+Image *renderSequenceFrames(RayTracer *raytracer, Scene &scene, ImageHandler *imageHandler) {
+    const unsigned frames = scene.frameCount();
+    Image *raytraced = nullptr;
+    for (unsigned frame = 0; frame < frames; frame++) {
+        if (frame > 0) {
+            scene.setFrame(frame);
+        }
+        delete raytraced;
+        raytraced = benchmarkRaytracer(raytracer, scene, false, false, frame);
+        std::string frameFile = sequenceFileName(outputFile, frame);
+        imageHandler->saveImage(frameFile, raytraced);
+        std::cout << "[Sequence] Frame " << frame + 1 << "/" << frames << ": bvh update " << scene.getBVHBuildMillis()
+                << " ms (" << scene.getBVHRefitCount() << " refit, " << scene.getBVHRebuildCount() << " rebuilt), "
+                << "raytracing " << TIMING_GET_DURATION(raytracer, RaytracingTimer::Component::TOTAL_RAYTRACING) <<
+                " ms, saved to " << frameFile << std::endl;
+    }
+    return raytraced;
+}
+
+/**
+ * Render the scene progressively: every pass traces one sample per pixel into a floating point accumulation buffer and
+ * the window shows the running average after every pass. Closing the window stops the render early.
+ * With adaptive sampling pixels whose standard error dropped below adaptiveError are skipped by the following passes
+ * and the passes continue until the rays of samples per pixel are spent on the remaining ones.
+ * @param raytracer the raytracer implementation to render with, only the cpu raytracers support passes
+ * @param scene prepared scene
+ * @param renderer window showing the passes, null to render without window
+ * @param imageHandler image handler saving the sample count image
+ * @return average of all rendered passes
+ */
+Image *renderProgressive(RayTracer *raytracer, const Scene &scene, Renderer *renderer, ImageHandler *imageHandler) {
+    // the error estimate of fewer samples is too unreliable to stop a pixel
+    constexpr unsigned adaptiveMinSamples = 4;
+    // no pixel takes more than this multiple of the samples per pixel from the budget
+    constexpr unsigned adaptiveMaxSamplesFactor = 4;
+    auto *cpuRaytracer = dynamic_cast<SequentialRayTracer *>(raytracer);
+    if (cpuRaytracer == nullptr) {
+        std::cerr << "Progressive rendering is only supported by the cpu raytracers, rendering all samples at once" <<
+                std::endl;
+        return benchmarkRaytracer(raytracer, scene, false, false);
+    }
+
+    AccumulationBuffer accumulation(windowSize);
+    auto *image = new Image(windowSize);
+    const uint64_t pixels = (uint64_t) windowSize.getX() * windowSize.getY();
+    const uint64_t sampleBudget = pixels * samples;
+    const bool adaptive = adaptiveError > 0;
+    const unsigned passes = adaptive ? samples * adaptiveMaxSamplesFactor : samples;
+    uint64_t samplesTraced = 0;
+    uint64_t activePixels = pixels;
+    auto renderStart = std::chrono::high_resolution_clock::now();
+    unsigned pass = 0;
+    for (; pass < passes && samplesTraced < sampleBudget && activePixels > 0 &&
+           (renderer == nullptr || renderer->isOpen()); pass++) {
+        auto passStart = std::chrono::high_resolution_clock::now();
+        cpuRaytracer->tracePass(scene, accumulation, pass);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - passStart).count();
+        samplesTraced += activePixels;
+        accumulation.resolve(image);
+        std::cout << "\r[Progressive] Pass " << pass + 1 << ": " << activePixels << " pixels, " <<
+                activePixels / seconds / 1e6 << " M samples/s" << std::flush;
+        if (renderer != nullptr) {
+            renderer->processEvents();
+            renderer->updateFPS((unsigned) (1 / seconds));
+            renderer->updateSPS((unsigned) (activePixels / seconds));
+            renderer->draw(image);
+        }
+        if (adaptive) {
+            activePixels = accumulation.updateConvergence(adaptiveError, adaptiveMinSamples,
+                                                          samples * adaptiveMaxSamplesFactor);
+        }
+    }
+    std::cout << "\r[Progressive] Rendered " << pass << " passes with " << (double) samplesTraced / pixels <<
+            " samples per pixel on average (" << samplesTraced << " samples, " << activePixels <<
+            " pixels not converged) in " <<
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count()
+            << " ms" << std::endl;
+
+    if (!sampleCountFile.empty()) {
+        Image sampleCounts(windowSize);
+        accumulation.resolveSampleCounts(&sampleCounts);
+        imageHandler->saveImage(sampleCountFile, &sampleCounts);
+        std::cout << "[Progressive] Saved samples per pixel to " << sampleCountFile << std::endl;
+    }
+    return image;
+}
+
+/**
+ * Print the structure of all hierarchies of the scene and append it to bvhstats.jsonl next to the benchmark file, one
+ * json object per line. CPU raytracers additionally trace every 16th camera ray again to count the node and triangle
+ * tests per ray.
+ * @param raytracer the raytracer implementation the scene was rendered with
+ * @param scene prepared scene
+ * @param frame frame of the scene animation that was rendered
+ */
+void reportBVHStatistics(RayTracer *raytracer, const Scene &scene, unsigned frame = 0) {
+    constexpr unsigned rayStride = 16;
+    BVHStatistics statistics = BVHStatistics::collect(scene);
+    if (auto *cpuRaytracer = dynamic_cast<SequentialRayTracer *>(raytracer)) {
+        cpuRaytracer->sampleTraversal(scene, statistics, rayStride);
+    }
+    statistics.print(std::cout);
+
+    nlohmann::json entry = statistics.toJson();
+    entry["implementation"] = raytracer->identifier();
+    entry["scene"] = scene.fileName;
+    entry["frame"] = frame;
+    entry["builder"] = BVHBuildSettings::builderName(scene.bvhBuildSettings.builder);
+    entry["layout"] = BVHBuildSettings::layoutName(scene.bvhBuildSettings.layout);
+    entry["gitHash"] = GIT_COMMIT_HASH;
+    std::filesystem::path statisticsFile = std::filesystem::path(benchmarkFile).parent_path() / "bvhstats.jsonl";
+    std::ofstream out(statisticsFile, std::ios::app);
+    out << entry.dump() << std::endl;
+    std::cout << "[BVHStats] Appended statistics to " << statisticsFile.string() << std::endl;
+}
+
 /// get all scene files in the scene directory and validate the json structure
 void sceneValidator() {
     auto files = std::filesystem::directory_iterator("scene/");
@@ -103,9 +370,18 @@ int main(int argc, char *argv[]) {
         std::cerr << "No implementation found for desired raytracer, using sequential implementation" << std::endl;
         raytracer = raytracerFactory->getSequentialImplementation();
     }
+    raytracer->setRenderSettings(renderSettings);
     std::cout << "Using raytracer implementation: " << raytracer->identifier() << std::endl;
 
     Scene scene = Scene::loadFromFile(sceneFile);
+    scene.bvhBuildSettings = bvhBuildSettings;
+    std::cout << "Using bvh builder: " << BVHBuildSettings::builderName(bvhBuildSettings.builder) << ", layout: " <<
+            BVHBuildSettings::layoutName(bvhBuildSettings.layout) << std::endl;
+
+    if (bvhBuildBenchmark) {
+        benchmarkBVHBuild(scene, bvhBuildSettings);
+        return 0;
+    }
 
     if (renderTests) {
         Image *uvTest = raytracer->uvTest();
@@ -119,22 +395,59 @@ int main(int argc, char *argv[]) {
     }
 
     scene.prepareRender();
+    std::cout << "Built bounding volume hierarchies in " << scene.getBVHBuildMillis() << " ms (" <<
+            scene.getBVHCacheHits() << "/" << scene.objects.size() << " loaded from cache), SAH cost " <<
+            scene.getBVHSAHCost() << std::endl;
 
-    Image *raytraced = benchmarkRaytracer(raytracer, scene, false, false);
+    if (bvhLayoutBenchmark) {
+        benchmarkBVHLayouts(raytracer, scene);
+        return 0;
+    }
 
-    imageHandler->saveImage(outputFile, raytraced);
+    Renderer *renderer = nullptr;
+#ifndef RUNNING_CICD
+    if (openWindow && progressive) {
+        renderer = new Renderer(windowSize, imageHandler);
+    }
+#endif
 
-    std::cout << "[" << raytracer->identifier() << "] Rendered raytrace image from scene " << sceneFile << " to " <<
-            outputFile << std::endl;
+    Image *raytraced;
+    if (progressive) {
+        raytraced = renderProgressive(raytracer, scene, renderer, imageHandler);
+
+        imageHandler->saveImage(outputFile, raytraced);
+
+        std::cout << "[" << raytracer->identifier() << "] Rendered raytrace image from scene " << sceneFile << " to "
+                << outputFile << std::endl;
+    } else if (renderSequence) {
+        raytraced = renderSequenceFrames(raytracer, scene, imageHandler);
+        std::cout << "[" << raytracer->identifier() << "] Rendered " << scene.frameCount() << " frames from scene " <<
+                sceneFile << std::endl;
+    } else {
+        raytraced = benchmarkRaytracer(raytracer, scene, false, false);
+
+        imageHandler->saveImage(outputFile, raytraced);
+
+        std::cout << "[" << raytracer->identifier() << "] Rendered raytrace image from scene " << sceneFile << " to "
+                << outputFile << std::endl;
+    }
+
+    if (bvhStatistics) {
+        reportBVHStatistics(raytracer, scene, renderSequence ? scene.frameCount() - 1 : 0);
+    }
 
 #ifndef RUNNING_CICD
     if (openWindow) {
-        auto renderer = Renderer(windowSize, imageHandler);
+        // progressive renders keep showing the window their passes were drawn in
+        if (renderer == nullptr) {
+            renderer = new Renderer(windowSize, imageHandler);
+        }
 
-        while (renderer.isOpen()) {
-            renderer.processEvents();
-            renderer.draw(raytraced);
+        while (renderer->isOpen()) {
+            renderer->processEvents();
+            renderer->draw(raytraced);
         }
+        delete renderer;
     }
 #endif
 
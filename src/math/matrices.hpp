@@ -161,6 +161,17 @@ namespace RayTracing {
             return result;
         }
 
+        /// Transpose the matrix
+        [[nodiscard]] Matrix<Y, X, T> transposed() const {
+            Matrix<Y, X, T> result;
+            for (unsigned int i = 0; i < X; ++i) {
+                for (unsigned int j = 0; j < Y; ++j) {
+                    result[j][i] = values[i][j];
+                }
+            }
+            return result;
+        }
+
         /// Create an identity matrix
         static Matrix<X, X, T> identity() {
             Matrix result;
@@ -185,5 +196,6 @@ namespace RayTracing {
     };
 
     typedef Matrix<3, 3, float> Mat3x3;
+    typedef Matrix<3, 4, float> Mat3x4;
     typedef Matrix<4, 4, float> Mat4x4;
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RAYTRACER_SIMD_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAYTRACER_SIMD_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RAYTRACER_SIMD_NEON
+#endif
+
+namespace RayTracing {
+    /// Four float lanes using SSE, NEON or a scalar fallback
+    struct Float4 {
+#if defined(RAYTRACER_SIMD_SSE)
+        __m128 v;
+
+        static Float4 load(const float *p) { return {_mm_loadu_ps(p)}; }
+        static Float4 broadcast(float value) { return {_mm_set1_ps(value)}; }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+        Float4 operator+(const Float4 &o) const { return {_mm_add_ps(v, o.v)}; }
+        Float4 operator-(const Float4 &o) const { return {_mm_sub_ps(v, o.v)}; }
+        Float4 operator*(const Float4 &o) const { return {_mm_mul_ps(v, o.v)}; }
+        Float4 operator/(const Float4 &o) const { return {_mm_div_ps(v, o.v)}; }
+        static Float4 min(const Float4 &a, const Float4 &b) { return {_mm_min_ps(a.v, b.v)}; }
+        static Float4 max(const Float4 &a, const Float4 &b) { return {_mm_max_ps(a.v, b.v)}; }
+        static Float4 sqrt(const Float4 &a) { return {_mm_sqrt_ps(a.v)}; }
+        /// Bit i is set if lane i of a is less or equal than lane i of b
+        static unsigned lessEqualMask(const Float4 &a, const Float4 &b) {
+            return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v));
+        }
+        /// Bit i is set if lane i of a is less than lane i of b
+        static unsigned lessMask(const Float4 &a, const Float4 &b) {
+            return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v));
+        }
+#elif defined(RAYTRACER_SIMD_NEON)
+        float32x4_t v;
+
+        static Float4 load(const float *p) { return {vld1q_f32(p)}; }
+        static Float4 broadcast(float value) { return {vdupq_n_f32(value)}; }
+        void store(float *p) const { vst1q_f32(p, v); }
+        Float4 operator+(const Float4 &o) const { return {vaddq_f32(v, o.v)}; }
+        Float4 operator-(const Float4 &o) const { return {vsubq_f32(v, o.v)}; }
+        Float4 operator*(const Float4 &o) const { return {vmulq_f32(v, o.v)}; }
+        Float4 operator/(const Float4 &o) const { return {vdivq_f32(v, o.v)}; }
+        static Float4 min(const Float4 &a, const Float4 &b) { return {vminq_f32(a.v, b.v)}; }
+        static Float4 max(const Float4 &a, const Float4 &b) { return {vmaxq_f32(a.v, b.v)}; }
+        static Float4 sqrt(const Float4 &a) { return {vsqrtq_f32(a.v)}; }
+        /// Bit i is set if lane i of a is less or equal than lane i of b
+        static unsigned lessEqualMask(const Float4 &a, const Float4 &b) {
+            static const uint32_t bits[4] = {1, 2, 4, 8};
+            return vaddvq_u32(vandq_u32(vcleq_f32(a.v, b.v), vld1q_u32(bits)));
+        }
+        /// Bit i is set if lane i of a is less than lane i of b
+        static unsigned lessMask(const Float4 &a, const Float4 &b) {
+            static const uint32_t bits[4] = {1, 2, 4, 8};
+            return vaddvq_u32(vandq_u32(vcltq_f32(a.v, b.v), vld1q_u32(bits)));
+        }
+#else
+        float v[4];
+
+        static Float4 load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+        static Float4 broadcast(float value) { return {{value, value, value, value}}; }
+        void store(float *p) const { std::copy(v, v + 4, p); }
+
+        Float4 operator+(const Float4 &o) const {
+            return {{v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]}};
+        }
+
+        Float4 operator-(const Float4 &o) const {
+            return {{v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3]}};
+        }
+
+        Float4 operator*(const Float4 &o) const {
+            return {{v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3]}};
+        }
+
+        Float4 operator/(const Float4 &o) const {
+            return {{v[0] / o.v[0], v[1] / o.v[1], v[2] / o.v[2], v[3] / o.v[3]}};
+        }
+
+        static Float4 min(const Float4 &a, const Float4 &b) {
+            return {
+                {std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3])}
+            };
+        }
+
+        static Float4 max(const Float4 &a, const Float4 &b) {
+            return {
+                {std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3])}
+            };
+        }
+
+        static Float4 sqrt(const Float4 &a) {
+            return {{std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])}};
+        }
+
+        /// Bit i is set if lane i of a is less or equal than lane i of b
+        static unsigned lessEqualMask(const Float4 &a, const Float4 &b) {
+            unsigned mask = 0;
+            for (unsigned i = 0; i < 4; i++) {
+                mask |= (a.v[i] <= b.v[i]) << i;
+            }
+            return mask;
+        }
+
+        /// Bit i is set if lane i of a is less than lane i of b
+        static unsigned lessMask(const Float4 &a, const Float4 &b) {
+            unsigned mask = 0;
+            for (unsigned i = 0; i < 4; i++) {
+                mask |= (a.v[i] < b.v[i]) << i;
+            }
+            return mask;
+        }
+#endif
+    };
+
+    /// Eight float lanes using AVX or two Float4
+    struct Float8 {
+#if defined(RAYTRACER_SIMD_AVX)
+        __m256 v;
+
+        static Float8 load(const float *p) { return {_mm256_loadu_ps(p)}; }
+        static Float8 broadcast(float value) { return {_mm256_set1_ps(value)}; }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+        Float8 operator+(const Float8 &o) const { return {_mm256_add_ps(v, o.v)}; }
+        Float8 operator-(const Float8 &o) const { return {_mm256_sub_ps(v, o.v)}; }
+        Float8 operator*(const Float8 &o) const { return {_mm256_mul_ps(v, o.v)}; }
+        Float8 operator/(const Float8 &o) const { return {_mm256_div_ps(v, o.v)}; }
+        static Float8 min(const Float8 &a, const Float8 &b) { return {_mm256_min_ps(a.v, b.v)}; }
+        static Float8 max(const Float8 &a, const Float8 &b) { return {_mm256_max_ps(a.v, b.v)}; }
+        static Float8 sqrt(const Float8 &a) { return {_mm256_sqrt_ps(a.v)}; }
+        /// Bit i is set if lane i of a is less or equal than lane i of b
+        static unsigned lessEqualMask(const Float8 &a, const Float8 &b) {
+            return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ));
+        }
+        /// Bit i is set if lane i of a is less than lane i of b
+        static unsigned lessMask(const Float8 &a, const Float8 &b) {
+            return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ));
+        }
+#else
+        Float4 low, high;
+
+        static Float8 load(const float *p) { return {Float4::load(p), Float4::load(p + 4)}; }
+        static Float8 broadcast(float value) { return {Float4::broadcast(value), Float4::broadcast(value)}; }
+
+        void store(float *p) const {
+            low.store(p);
+            high.store(p + 4);
+        }
+
+        Float8 operator+(const Float8 &o) const { return {low + o.low, high + o.high}; }
+        Float8 operator-(const Float8 &o) const { return {low - o.low, high - o.high}; }
+        Float8 operator*(const Float8 &o) const { return {low * o.low, high * o.high}; }
+        Float8 operator/(const Float8 &o) const { return {low / o.low, high / o.high}; }
+        static Float8 min(const Float8 &a, const Float8 &b) {
+            return {Float4::min(a.low, b.low), Float4::min(a.high, b.high)};
+        }
+        static Float8 max(const Float8 &a, const Float8 &b) {
+            return {Float4::max(a.low, b.low), Float4::max(a.high, b.high)};
+        }
+        static Float8 sqrt(const Float8 &a) { return {Float4::sqrt(a.low), Float4::sqrt(a.high)}; }
+        /// Bit i is set if lane i of a is less or equal than lane i of b
+        static unsigned lessEqualMask(const Float8 &a, const Float8 &b) {
+            return Float4::lessEqualMask(a.low, b.low) | Float4::lessEqualMask(a.high, b.high) << 4;
+        }
+        /// Bit i is set if lane i of a is less than lane i of b
+        static unsigned lessMask(const Float8 &a, const Float8 &b) {
+            return Float4::lessMask(a.low, b.low) | Float4::lessMask(a.high, b.high) << 4;
+        }
+#endif
+    };
+
+    /// Lane type with the given number of floats
+    template<unsigned Width>
+    struct FloatLanes;
+
+    template<>
+    struct FloatLanes<4> {
+        using Type = Float4;
+    };
+
+    template<>
+    struct FloatLanes<8> {
+        using Type = Float8;
+    };
+}
@@ -160,6 +160,34 @@ namespace RayTracing {
             return sum;
         }
 
+        /**
+         * Component wise minimum of two vectors
+         * @param a first vector
+         * @param b second vector
+         * @return vector containing the smaller value of each dimension
+         */
+        static Vector componentMin(const Vector &a, const Vector &b) {
+            Vector v;
+            for (unsigned int i = 0; i < X; i++) {
+                v.values[i] = std::min(a.values[i], b.values[i]);
+            }
+            return v;
+        }
+
+        /**
+         * Component wise maximum of two vectors
+         * @param a first vector
+         * @param b second vector
+         * @return vector containing the larger value of each dimension
+         */
+        static Vector componentMax(const Vector &a, const Vector &b) {
+            Vector v;
+            for (unsigned int i = 0; i < X; i++) {
+                v.values[i] = std::max(a.values[i], b.values[i]);
+            }
+            return v;
+        }
+
         /**
          * Check if any component is NaN
          * @return true if any component is NaN
@@ -397,6 +425,17 @@ namespace RayTracing {
             return v;
         }
 
+        /// Generate a random vector with normally distributed components from a given generator, so the sequence only
+        /// depends on its seed and not on the thread that draws it
+        static Vector random(std::mt19937 &gen) {
+            std::normal_distribution<T> dist(0.0f, 0.8f);
+            Vector v;
+            for (unsigned int i = 0; i < X; i++) {
+                v[i] = dist(gen);
+            }
+            return v;
+        }
+
 #ifdef USE_SHADER_METAL
         /// Convert to Metal simd type uint2
         [[nodiscard]] simd::uint2 toMetal() const requires (X == 2 && std::is_same<T, unsigned>::value) {
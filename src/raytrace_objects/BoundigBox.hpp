@@ -43,6 +43,40 @@ namespace RayTracing {
             return maxPos - minPos;
         }
 
+        /// Returns an inverted box that can be grown by points and boxes
+        static BoundingBox empty() {
+            return {Vec3(INFINITY), Vec3(-INFINITY)};
+        }
+
+        /// Returns true if the box does not contain any point
+        [[nodiscard]] bool isEmpty() const {
+            return minPos.getX() > maxPos.getX() || minPos.getY() > maxPos.getY() || minPos.getZ() > maxPos.getZ();
+        }
+
+        /// Grows the bounding box to contain the given point
+        void grow(const Vec3 &p) {
+            minPos = Vec3::componentMin(minPos, p);
+            maxPos = Vec3::componentMax(maxPos, p);
+        }
+
+        /// Grows the bounding box to contain the given box
+        void grow(const BoundingBox &box) {
+            minPos = Vec3::componentMin(minPos, box.minPos);
+            maxPos = Vec3::componentMax(maxPos, box.maxPos);
+        }
+
+        /// Returns the overlap of two boxes, an empty box if they do not overlap
+        [[nodiscard]] BoundingBox intersection(const BoundingBox &box) const {
+            return {Vec3::componentMax(minPos, box.minPos), Vec3::componentMin(maxPos, box.maxPos)};
+        }
+
+        /// Returns the surface area of the bounding box, 0 for empty boxes
+        [[nodiscard]] float surfaceArea() const {
+            if (isEmpty()) return 0;
+            Vec3 s = size();
+            return 2.0f * (s.getX() * s.getY() + s.getY() * s.getZ() + s.getZ() * s.getX());
+        }
+
         /**
          * Checks if a point is inside the bounding box
          * @param p The point to check
@@ -55,7 +89,7 @@ namespace RayTracing {
         }
 
 #ifdef USE_SHADER_METAL
-        Metal_NestedBoundingBox toMetalBasic() {
+        Metal_NestedBoundingBox toMetalBasic() const {
             return {minPos.toMetal(), maxPos.toMetal()};
         }
 #endif
@@ -63,10 +97,10 @@ namespace RayTracing {
 
     /// Nested bounding box for spatial partitioning
     struct NestedBoundingBox : public BoundingBox {
-        /// containing the triangle indices list for this bounding box
-        std::vector<int> indices;
-        /// containing the triangle normals list for this bounding box
-        std::vector<Vec3> normals;
+        /// leaf: index of the first triangle in the triangle order created by the builder
+        unsigned trianglesOffset;
+        /// leaf: number of triangles, 0 for inner boxes
+        unsigned triangleCount;
         /// child left bounding box
         NestedBoundingBox *left;
         /// child right bounding box
@@ -77,7 +111,8 @@ namespace RayTracing {
         Vec3::Direction splitAxis;
 
         /// Default constructor for easier initialization
-        NestedBoundingBox() : BoundingBox(), left(nullptr), right(nullptr), splitValue(0), splitAxis(Vec3::X_AXIS) {
+        NestedBoundingBox() : BoundingBox(), trianglesOffset(0), triangleCount(0), left(nullptr), right(nullptr),
+                              splitValue(0), splitAxis(Vec3::X_AXIS) {
         }
 
         ~NestedBoundingBox() {
@@ -88,18 +123,19 @@ namespace RayTracing {
         /**
          * Creates a nested bounding box for spatial partitioning
          * @param box parent bounding box
-         * @param indices indices of objects contained in this box
+         * @param trianglesOffset index of the first triangle of a leaf in the triangle order of the builder
+         * @param triangleCount number of triangles of a leaf, 0 for inner boxes
          * @param left child left bounding box
          * @param right child right bounding box
          * @param split_value value at which the box is split
          * @param split_axis axis along which the box is split
          */
-        NestedBoundingBox(const BoundingBox &box, const std::vector<int> &indices, const std::vector<Vec3> &normals,
+        NestedBoundingBox(const BoundingBox &box, unsigned trianglesOffset, unsigned triangleCount,
                           NestedBoundingBox *left, NestedBoundingBox *right, float split_value,
                           Vec3::Direction split_axis)
             : BoundingBox(box.minPos, box.maxPos),
-              indices(indices),
-              normals(normals),
+              trianglesOffset(trianglesOffset),
+              triangleCount(triangleCount),
               left(left),
               right(right),
               splitValue(split_value),
@@ -131,8 +167,24 @@ namespace RayTracing {
         }
 
         bool operator==(const NestedBoundingBox &lhs) const {
-            return minPos == lhs.minPos && maxPos == lhs.maxPos && indices == lhs.indices && splitValue == lhs.
-                   splitValue && splitAxis == lhs.splitAxis;
+            return minPos == lhs.minPos && maxPos == lhs.maxPos && trianglesOffset == lhs.trianglesOffset &&
+                   triangleCount == lhs.triangleCount && splitValue == lhs.splitValue && splitAxis == lhs.splitAxis;
+        }
+
+        /**
+         * Compares this box and all of its children with another tree
+         * @param other root of the other tree
+         * @return true if both trees have the same structure and all boxes are equal
+         */
+        [[nodiscard]] bool treeEquals(const NestedBoundingBox &other) const {
+            if (!(*this == other)) {
+                return false;
+            }
+            if ((left == nullptr) != (other.left == nullptr) || (right == nullptr) != (other.right == nullptr)) {
+                return false;
+            }
+            return (left == nullptr || left->treeEquals(*other.left)) &&
+                   (right == nullptr || right->treeEquals(*other.right));
         }
     };
 }
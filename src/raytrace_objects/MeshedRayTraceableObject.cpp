@@ -1,8 +1,11 @@
 #include "MeshedRayTraceableObject.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <stl_reader.h>
 
+#include "../bvh/BVHCache.hpp"
+
 namespace RayTracing {
     std::pair<std::vector<unsigned>, std::vector<unsigned> > Mesh::split(float value, Vec3::Direction axis) {
         std::vector<unsigned> indicesLeft = {};
@@ -18,9 +21,50 @@ namespace RayTracing {
         return {indicesLeft, indicesRight};
     }
 
+    void Mesh::reorderTriangles(const std::vector<unsigned> &order) {
+        // position of a stored copy of every file triangle, duplicates are identical so any copy will do
+        std::vector<unsigned> position(fileTriangleCount);
+        for (unsigned triangle = 0; triangle < numTriangles; triangle++) {
+            position[fileTriangles[triangle]] = triangle;
+        }
+
+        std::vector<int> orderedIndices(order.size() * 3);
+        std::vector<Vec3> orderedNormals(order.size());
+        for (unsigned i = 0; i < order.size(); i++) {
+            unsigned source = position[order[i]];
+            orderedIndices[i * 3 + 0] = indices[source * 3 + 0];
+            orderedIndices[i * 3 + 1] = indices[source * 3 + 1];
+            orderedIndices[i * 3 + 2] = indices[source * 3 + 2];
+            orderedNormals[i] = normals[source];
+        }
+        indices = std::move(orderedIndices);
+        normals = std::move(orderedNormals);
+        fileTriangles = order;
+        numTriangles = order.size();
+        // the blocks are compiled per leaf and are rebuilt once the leaves of the new order are known
+        triangleBlocks.clear();
+    }
+
+    void Mesh::restoreFileOrder() {
+        bool inFileOrder = numTriangles == fileTriangleCount;
+        for (unsigned triangle = 0; inFileOrder && triangle < numTriangles; triangle++) {
+            inFileOrder = fileTriangles[triangle] == triangle;
+        }
+        if (inFileOrder) {
+            return;
+        }
+        std::vector<unsigned> order(fileTriangleCount);
+        for (unsigned triangle = 0; triangle < fileTriangleCount; triangle++) {
+            order[triangle] = triangle;
+        }
+        reorderTriangles(order);
+    }
+
 
     void MeshedRayTraceableObject::loadMesh(const std::string &baseDir) {
         mesh = new Mesh();
+        meshDirectory = baseDir;
+        meshHash = 0;
         try {
             Vec3 minLoc = {INFINITY, INFINITY, INFINITY};
             Vec3 maxLoc = {-INFINITY, -INFINITY, -INFINITY};
@@ -43,14 +87,34 @@ namespace RayTracing {
                 }
                 const float *n = stl_mesh.tri_normal(itri);
                 mesh->normals.emplace_back(n[0], n[1], n[2]);
+                mesh->fileTriangles.push_back(itri);
             }
             mesh->numTriangles = stl_mesh.num_tris();
+            mesh->fileTriangleCount = stl_mesh.num_tris();
             this->boundingBox = {minLoc, maxLoc};
         } catch (std::exception &e) {
             std::cerr << e.what() << std::endl;
         }
     }
 
+    void MeshedRayTraceableObject::shareGeometry(MeshedRayTraceableObject &owner) {
+        instanceOf = &owner;
+        mesh = owner.mesh;
+        meshDirectory = owner.meshDirectory;
+        meshHash = owner.meshHash;
+        linearBVH = owner.linearBVH;
+        bvh4 = owner.bvh4;
+        bvh8 = owner.bvh8;
+        bvh4q8 = owner.bvh4q8;
+        bvh4q16 = owner.bvh4q16;
+        bvh8q8 = owner.bvh8q8;
+        bvh8q16 = owner.bvh8q16;
+        bvhLayout = owner.bvhLayout;
+        builtSAHCost = owner.builtSAHCost;
+        loadedFromCache = owner.loadedFromCache;
+        boundingBox = owner.boundingBox;
+    }
+
     void MeshedRayTraceableObject::updateBoundingBox() {
         Vec3 minLoc = {INFINITY, INFINITY, INFINITY};
         Vec3 maxLoc = {-INFINITY, -INFINITY, -INFINITY};
@@ -63,91 +127,197 @@ namespace RayTracing {
         this->boundingBox = {minLoc, maxLoc};
     }
 
-    void MeshedRayTraceableObject::updateNestedBoundingBox(unsigned maxTrianglesPerBox) {
-        this->nestedBoundingBox = updateNestedBoundingBoxRecursive(mesh->indices,
-                                                                   mesh->normals,
-                                                                   maxTrianglesPerBox,
-                                                                   mesh->numTriangles);
-    }
+    void MeshedRayTraceableObject::updateNestedBoundingBox(const BVHBuildSettings &settings) {
+        // the cache holds hierarchies of the mesh as stored in the file, deformed meshes are always built
+        bool cacheable = settings.useCache && morphWeight == 0;
+        if (cacheable && meshHash == 0) {
+            meshHash = BVHCache::hashFile(meshDirectory + "/" + fileName);
+        }
+        cacheable &= meshHash != 0;
+        std::string cacheFile = cacheable ? BVHCache::cachePath(meshDirectory, fileName, meshHash, settings) : "";
+
+        std::vector<unsigned> triangleOrder;
+        LinearBVH *cached = cacheable
+                                ? BVHCache::load(cacheFile, meshHash, settings, mesh->fileTriangleCount, triangleOrder)
+                                : nullptr;
+        loadedFromCache = cached != nullptr;
+        delete this->linearBVH;
+        if (loadedFromCache) {
+            this->linearBVH = cached;
+        } else {
+            // builders index the triangles in file order, drop the leaf order and duplicates of the last build
+            mesh->restoreFileOrder();
+            BVHBuilder *builder = BVHBuilder::create(settings);
+            NestedBoundingBox *nestedBoundingBox = builder->build(*mesh, triangleOrder);
+            delete builder;
 
-    NestedBoundingBox *MeshedRayTraceableObject::updateNestedBoundingBoxRecursive(
-        const std::vector<int> &indices, const std::vector<Vec3> &normals, unsigned maxTrianglesPerBox,
-        unsigned triangleCount) {
-        BoundingBox innerBoundingBox = calculateBoundingBoxForIndices(indices);
-        if (indices.size() / 3 <= maxTrianglesPerBox) {
-            return new NestedBoundingBox{
-                innerBoundingBox, indices, normals, nullptr, nullptr, 0, Vec3::X_AXIS
-            };
-        }
-        // get longest axis to split along
-        Vec3::Direction splitAxis = Vec3::X_AXIS;
-        float length = 0;
-        for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
-            float axisLength = innerBoundingBox.maxPos.getValue(axis) - innerBoundingBox.minPos.getValue(axis);
-            if (axisLength > length) {
-                length = axisLength;
-                splitAxis = axis;
+            this->linearBVH = new LinearBVH(nestedBoundingBox);
+            delete nestedBoundingBox;
+
+            if (cacheable && !BVHCache::store(cacheFile, meshHash, settings, *linearBVH, triangleOrder)) {
+                std::cerr << "Could not write bvh cache file " << cacheFile << std::endl;
             }
         }
+        mesh->reorderTriangles(triangleOrder);
+        mesh->triangleBlocks.build(*mesh, *linearBVH);
 
-        // split triangles along axis center
-        std::vector<int> indicesLeft = {};
-        std::vector<Vec3> normalsLeft = {};
-        std::vector<int> indicesRight = {};
-        std::vector<Vec3> normalsRight = {};
-        float splitValue = innerBoundingBox.minPos.getValue(splitAxis) + (length / 2.0f);
-        for (unsigned triangle = 0; triangle < triangleCount; triangle++) {
-            bool left = false;
-            bool right = false;
-            unsigned triangleStartIndex = triangle * 3;
-            for (int i = 0; i < 3; i++) {
-                float axisValue = mesh->vertices[indices[triangleStartIndex + i]].getValue(splitAxis);
-                if (axisValue <= splitValue) {
-                    left = true;
-                } else {
-                    right = true;
-                }
-            }
-            if (left) {
-                indicesLeft.push_back(indices[triangleStartIndex + 0]);
-                indicesLeft.push_back(indices[triangleStartIndex + 1]);
-                indicesLeft.push_back(indices[triangleStartIndex + 2]);
-                normalsLeft.push_back(normals[triangle]);
+        builtSAHCost = linearBVH->sahCost(settings.traversalCost, settings.intersectionCost);
+        updateWideBVH(settings.layout);
+    }
+
+    bool MeshedRayTraceableObject::refitNestedBoundingBox(const BVHBuildSettings &settings) {
+        linearBVH->refit(*mesh);
+        float cost = linearBVH->sahCost(settings.traversalCost, settings.intersectionCost);
+        if (cost > builtSAHCost * settings.refitRebuildThreshold) {
+            updateNestedBoundingBox(settings);
+            return true;
+        }
+        mesh->triangleBlocks.build(*mesh, *linearBVH);
+        updateWideBVH(settings.layout);
+        return false;
+    }
+
+    void MeshedRayTraceableObject::updateWideBVH(BVHLayout layout) {
+        if (instanceOf != nullptr) {
+            // the hierarchies belong to the owner, it is only collapsed once for all of its instances
+            if (instanceOf->bvhLayout != layout) {
+                instanceOf->updateWideBVH(layout);
             }
-            if (right) {
-                indicesRight.push_back(indices[triangleStartIndex + 0]);
-                indicesRight.push_back(indices[triangleStartIndex + 1]);
-                indicesRight.push_back(indices[triangleStartIndex + 2]);
-                normalsRight.push_back(normals[triangle]);
+            shareGeometry(*instanceOf);
+            return;
+        }
+        delete this->bvh4;
+        delete this->bvh8;
+        delete this->bvh4q8;
+        delete this->bvh4q16;
+        delete this->bvh8q8;
+        delete this->bvh8q16;
+        bool wide4 = layout == BVHLayout::BVH4 || layout == BVHLayout::BVH4_Q8 || layout == BVHLayout::BVH4_Q16;
+        bool wide8 = layout == BVHLayout::BVH8 || layout == BVHLayout::BVH8_Q8 || layout == BVHLayout::BVH8_Q16;
+        this->bvh4 = wide4 ? new WideBVH<4>(*linearBVH) : nullptr;
+        this->bvh8 = wide8 ? new WideBVH<8>(*linearBVH) : nullptr;
+        this->bvh4q8 = layout == BVHLayout::BVH4_Q8 ? new QuantizedWideBVH<4, uint8_t>(*bvh4) : nullptr;
+        this->bvh4q16 = layout == BVHLayout::BVH4_Q16 ? new QuantizedWideBVH<4, uint16_t>(*bvh4) : nullptr;
+        this->bvh8q8 = layout == BVHLayout::BVH8_Q8 ? new QuantizedWideBVH<8, uint8_t>(*bvh8) : nullptr;
+        this->bvh8q16 = layout == BVHLayout::BVH8_Q16 ? new QuantizedWideBVH<8, uint16_t>(*bvh8) : nullptr;
+        if (layout != BVHLayout::BVH4 && layout != BVHLayout::BVH8) {
+            // the uncompressed wide nodes were only needed to compress them
+            delete this->bvh4;
+            delete this->bvh8;
+            this->bvh4 = nullptr;
+            this->bvh8 = nullptr;
+        }
+        this->bvhLayout = layout;
+    }
+
+    size_t MeshedRayTraceableObject::hierarchyMemoryUsage() const {
+        if (linearBVH == nullptr || instanceOf != nullptr) {
+            return 0;
+        }
+        return linearBVH->memoryUsage() + mesh->triangleBlocks.memoryUsage() +
+               (bvh4 != nullptr ? bvh4->memoryUsage() : 0) + (bvh8 != nullptr ? bvh8->memoryUsage() : 0) +
+               (bvh4q8 != nullptr ? bvh4q8->memoryUsage() : 0) + (bvh4q16 != nullptr ? bvh4q16->memoryUsage() : 0) +
+               (bvh8q8 != nullptr ? bvh8q8->memoryUsage() : 0) + (bvh8q16 != nullptr ? bvh8q16->memoryUsage() : 0);
+    }
+
+    void MeshedRayTraceableObject::loadMorphTarget(const std::string &baseDir) {
+        stl_reader::StlMesh<float, unsigned int> stl_mesh(baseDir + "/" + animation.morphTarget);
+        if (stl_mesh.num_tris() != mesh->fileTriangleCount) {
+            throw std::runtime_error("Morph target " + animation.morphTarget + " has a different triangle count than " +
+                                     fileName);
+        }
+        // vertices are matched by the triangle corners they belong to, the vertex order of both files may differ
+        morphTargetVertices = mesh->vertices;
+        baseNormals.resize(mesh->fileTriangleCount);
+        for (unsigned triangle = 0; triangle < mesh->numTriangles; triangle++) {
+            const unsigned itri = mesh->fileTriangles[triangle];
+            for (size_t icorner = 0; icorner < 3; ++icorner) {
+                const float *c = stl_mesh.vrt_coords(stl_mesh.tri_corner_ind(itri, icorner));
+                morphTargetVertices[mesh->indices[triangle * 3 + icorner]] = Vec3(c[0], c[1], c[2]);
             }
+            baseNormals[itri] = mesh->normals[triangle];
         }
+        baseVertices = mesh->vertices;
+    }
 
-        /// Check if split was possible and prevent (call)stack overflow
-        if (indicesLeft.size() == indices.size() || indicesRight.size() == indices.size()) {
-            // unable to split further
-            return new NestedBoundingBox{
-                innerBoundingBox, indices, normals, nullptr, nullptr, 0, Vec3::X_AXIS
-            };
+    bool MeshedRayTraceableObject::applyFrame(unsigned frame) {
+        if (!animation.isAnimated()) {
+            return false;
+        }
+        Keyframe keyframe = animation.sample(frame);
+        transform.setTranslation(keyframe.position);
+        transform.setRotation(keyframe.rotation);
+        transform.setScale(keyframe.scale);
+        if (morphTargetVertices.empty() || keyframe.morph == morphWeight) {
+            return false;
         }
 
-        return new NestedBoundingBox{
-            innerBoundingBox, {}, {},
-            updateNestedBoundingBoxRecursive(indicesLeft, normalsLeft, maxTrianglesPerBox, indicesLeft.size() / 3),
-            updateNestedBoundingBoxRecursive(indicesRight, normalsRight, maxTrianglesPerBox, indicesRight.size() / 3),
-            splitValue, splitAxis
-        };
+        morphWeight = keyframe.morph;
+        for (unsigned i = 0; i < mesh->vertices.size(); i++) {
+            mesh->vertices[i] = baseVertices[i] + (morphTargetVertices[i] - baseVertices[i]) * morphWeight;
+        }
+        for (unsigned triangle = 0; triangle < mesh->numTriangles; triangle++) {
+            const Vec3 &a = mesh->vertices[mesh->indices[triangle * 3 + 0]];
+            const Vec3 &b = mesh->vertices[mesh->indices[triangle * 3 + 1]];
+            const Vec3 &c = mesh->vertices[mesh->indices[triangle * 3 + 2]];
+            Vec3 normal = Vec3::cross(b - a, c - a);
+            if (Vec3::dot(normal, normal) > 0) {
+                normal = normal.normalized();
+                const Vec3 &baseNormal = baseNormals[mesh->fileTriangles[triangle]];
+                mesh->normals[triangle] = Vec3::dot(normal, baseNormal) < 0 ? normal * -1 : normal;
+            }
+        }
+        updateBoundingBox();
+        return true;
     }
 
-    BoundingBox MeshedRayTraceableObject::calculateBoundingBoxForIndices(const std::vector<int> &indices) const {
-        Vec3 minLoc = {INFINITY, INFINITY, INFINITY};
-        Vec3 maxLoc = {-INFINITY, -INFINITY, -INFINITY};
-        for (auto index: indices) {
-            Vec3 v = mesh->vertices[index];
-            minLoc = Vec3(std::min(minLoc.getX(), v.getX()), std::min(minLoc.getY(), v.getY()),
-                          std::min(minLoc.getZ(), v.getZ()));
-            maxLoc = Vec3(std::max(maxLoc.getX(), v.getX()), std::max(maxLoc.getY(), v.getY()),
-                          std::max(maxLoc.getZ(), v.getZ()));
+    HitInfo MeshedRayTraceableObject::intersect(const LocalRay &ray, TraversalCounters *counters) const {
+        if (counters != nullptr) {
+            counters->rays++;
+        }
+        switch (bvhLayout) {
+            case BVHLayout::BVH4:
+                return bvh4->intersect(ray, *mesh, counters);
+            case BVHLayout::BVH8:
+                return bvh8->intersect(ray, *mesh, counters);
+            case BVHLayout::BVH4_Q8:
+                return bvh4q8->intersect(ray, *mesh, counters);
+            case BVHLayout::BVH4_Q16:
+                return bvh4q16->intersect(ray, *mesh, counters);
+            case BVHLayout::BVH8_Q8:
+                return bvh8q8->intersect(ray, *mesh, counters);
+            case BVHLayout::BVH8_Q16:
+                return bvh8q16->intersect(ray, *mesh, counters);
+            case BVHLayout::BINARY:
+            default:
+                return linearBVH->intersect(ray, *mesh, counters);
         }
-        return {minLoc, maxLoc};
+    }
+
+    bool MeshedRayTraceableObject::occluded(const LocalRay &ray, float maxDistance, TraversalCounters *counters) const {
+        if (counters != nullptr) {
+            counters->rays++;
+        }
+        switch (bvhLayout) {
+            case BVHLayout::BVH4:
+                return bvh4->occluded(ray, *mesh, maxDistance, counters);
+            case BVHLayout::BVH8:
+                return bvh8->occluded(ray, *mesh, maxDistance, counters);
+            case BVHLayout::BVH4_Q8:
+                return bvh4q8->occluded(ray, *mesh, maxDistance, counters);
+            case BVHLayout::BVH4_Q16:
+                return bvh4q16->occluded(ray, *mesh, maxDistance, counters);
+            case BVHLayout::BVH8_Q8:
+                return bvh8q8->occluded(ray, *mesh, maxDistance, counters);
+            case BVHLayout::BVH8_Q16:
+                return bvh8q16->occluded(ray, *mesh, maxDistance, counters);
+            case BVHLayout::BINARY:
+            default:
+                return linearBVH->occluded(ray, *mesh, maxDistance, counters);
+        }
+    }
+
+    void MeshedRayTraceableObject::intersectPacket(RayPacket &packet, uint64_t mask) const {
+        linearBVH->intersectPacket(packet, mask, *mesh);
     }
 }
@@ -4,18 +4,46 @@
 #include <vector>
 
 #include "RayTracableObject.hpp"
+#include "../bvh/BVHBuilder.hpp"
+#include "../bvh/LinearBVH.hpp"
+#include "../bvh/QuantizedBVH.hpp"
+#include "../bvh/TriangleBlocks.hpp"
+#include "../bvh/WideBVH.hpp"
+#include "../Animation.hpp"
 
 namespace RayTracing {
-    /// Triangle mesh structure
+    /**
+     * Triangle mesh structure.
+     * The triangles are stored in the order of the mesh file until a hierarchy is built, which reorders them into
+     * leaf order. Builders that duplicate triangles store them once per referencing leaf.
+     */
     struct Mesh {
     public:
         std::vector<Vec3> vertices;
+        /// vertex indices, three per triangle
         std::vector<int> indices;
+        /// one normal per triangle
         std::vector<Vec3> normals;
+        /// index in the mesh file of every stored triangle
+        std::vector<unsigned> fileTriangles;
+        /// triangles compiled per leaf for the SIMD triangle test, built together with the hierarchy
+        TriangleBlocks triangleBlocks;
 
-        unsigned numTriangles;
+        /// number of stored triangles, including duplicates
+        unsigned numTriangles = 0;
+        /// number of triangles in the mesh file
+        unsigned fileTriangleCount = 0;
 
         std::pair<std::vector<unsigned>, std::vector<unsigned> > split(float value, Vec3::Direction axis);
+
+        /**
+         * Rearrange the stored triangles, vertices are not changed
+         * @param order mesh file index of every triangle in the new order, an index may be listed more than once
+         */
+        void reorderTriangles(const std::vector<unsigned> &order);
+
+        /// Store every triangle exactly once in the order of the mesh file again
+        void restoreFileOrder();
     };
 
     /// Serializable representation of a meshed ray traceable object
@@ -31,9 +59,42 @@ namespace RayTracing {
     class MeshedRayTraceableObject : public RayTraceableObject {
     public:
         std::string fileName;
+        /// directory the mesh was loaded from
+        std::string meshDirectory;
+        /// content hash of the mesh file, calculated on the first build that uses the hierarchy cache
+        uint64_t meshHash = 0;
         Mesh *mesh = nullptr;
 
-        NestedBoundingBox *nestedBoundingBox = nullptr;
+        /// flattened bounding volume hierarchy of the mesh, its leaves reference ranges of the reordered mesh
+        LinearBVH *linearBVH = nullptr;
+        /// linearBVH collapsed into 4-wide nodes, only built for the BVH4 layout
+        WideBVH<4> *bvh4 = nullptr;
+        /// linearBVH collapsed into 8-wide nodes, only built for the BVH8 layout
+        WideBVH<8> *bvh8 = nullptr;
+        /// compressed wide hierarchies, only the one of the selected quantized layout is built
+        QuantizedWideBVH<4, uint8_t> *bvh4q8 = nullptr;
+        QuantizedWideBVH<4, uint16_t> *bvh4q16 = nullptr;
+        QuantizedWideBVH<8, uint8_t> *bvh8q8 = nullptr;
+        QuantizedWideBVH<8, uint16_t> *bvh8q16 = nullptr;
+        /// layout used by intersect
+        BVHLayout bvhLayout = BVHLayout::BINARY;
+        /// SAH cost of linearBVH right after its last full build, refits are compared against it
+        float builtSAHCost = 0;
+        /// true if linearBVH was loaded from the hierarchy cache instead of being built
+        bool loadedFromCache = false;
+
+        /// keyframed transform and morph weight, empty for static objects
+        Animation animation;
+        /// vertices as loaded from the file, the morph target is blended onto them
+        std::vector<Vec3> baseVertices;
+        /// triangle normals as loaded from the file, by triangle index of the mesh file
+        std::vector<Vec3> baseNormals;
+        /// vertices of the morph target by vertex index of the mesh, empty if the mesh is not deformed
+        std::vector<Vec3> morphTargetVertices;
+        /// morph weight the vertices of the mesh are currently blended with
+        float morphWeight = 0;
+        /// object owning the mesh and hierarchies this object shares, null if the object owns them itself
+        MeshedRayTraceableObject *instanceOf = nullptr;
 
         MeshedRayTraceableObject() : RayTraceableObject({}, {}, Vec3(1), {}) {
         };
@@ -55,25 +116,86 @@ namespace RayTracing {
          */
         void loadMesh(const std::string &baseDir);
 
+        /**
+         * Turn the object into an instance of another object: the mesh and its hierarchies are shared instead of
+         * loaded and built again, only transform and material stay per object. Has to be called again whenever the
+         * owner rebuilt its hierarchies.
+         * @param owner object that loaded the mesh, must not be deformed by a morph target
+         */
+        void shareGeometry(MeshedRayTraceableObject &owner);
+
+        /**
+         * Load the morph target of the animation from file in baseDir.
+         * The morph target has to have the same triangles in the same order as the mesh, only the positions differ.
+         * @param baseDir Base directory where the mesh file is located
+         */
+        void loadMorphTarget(const std::string &baseDir);
+
+        /**
+         * Apply the transform and morph weight of the animation at a frame, the transform still has to be updated
+         * @param frame frame to apply
+         * @return true if the vertices of the mesh moved and the hierarchy has to be refit
+         */
+        bool applyFrame(unsigned frame);
+
         /**
          * Calculate and update the bounding box of the meshed object
          */
         void updateBoundingBox() override;
 
         /**
-         * Update the nested bounding box for spatial partitioning
-         * @param maxTrianglesPerBox Maximum number of triangles allowed per bounding box
+         * Update the nested bounding box for spatial partitioning, flatten it into linearBVH and reorder the triangles
+         * of the mesh into leaf order. If the cache is enabled and the mesh is not deformed, the hierarchy is loaded
+         * from the cache file matching the mesh and settings, a newly built hierarchy is stored in the cache.
+         * @param settings settings selecting and configuring the hierarchy builder
          */
-        void updateNestedBoundingBox(unsigned maxTrianglesPerBox);
+        void updateNestedBoundingBox(const BVHBuildSettings &settings);
 
-    private:
-        /// Recursively update the nested bounding box
-        NestedBoundingBox *updateNestedBoundingBoxRecursive(const std::vector<int> &indices,
-                                                            const std::vector<Vec3> &normals,
-                                                            unsigned maxTrianglesPerBox,
-                                                            unsigned triangleCount);
+        /**
+         * Refit the hierarchy to the moved vertices of the mesh, or rebuild it if the SAH cost after the refit grew
+         * by more than settings.refitRebuildThreshold compared to the last full build
+         * @param settings settings the hierarchy was built with
+         * @return true if the hierarchy was rebuilt
+         */
+        bool refitNestedBoundingBox(const BVHBuildSettings &settings);
+
+        /**
+         * Collapse linearBVH into the wide or quantized hierarchy of the layout and select the layout for intersect.
+         * The hierarchies of all other layouts are released. Instances switch the layout of their owner.
+         * @param layout node layout to traverse
+         */
+        void updateWideBVH(BVHLayout layout);
+
+        /// Get the memory of the nodes of linearBVH, of the hierarchy of the selected layout and of the triangle blocks
+        /// in bytes, 0 for instances as their owner already holds it
+        [[nodiscard]] size_t hierarchyMemoryUsage() const;
+
+        /**
+         * Find the closest intersection of a ray with the mesh using the hierarchy of the selected layout
+         * @param ray ray in local object space
+         * @param counters if not null, the ray and its node and triangle tests are added to it
+         * @return closest intersection in local object space
+         */
+        [[nodiscard]] HitInfo intersect(const LocalRay &ray, TraversalCounters *counters = nullptr) const;
 
-        /// Calculate the bounding box for given indices
-        [[nodiscard]] BoundingBox calculateBoundingBoxForIndices(const std::vector<int> &indices) const;
+        /**
+         * Check if a ray hits the mesh closer than maxDistance using the hierarchy of the selected layout, stopping at
+         * the first hit found
+         * @param ray ray in local object space
+         * @param maxDistance only hits closer than this distance in local object space count
+         * @param counters if not null, the query and its node and triangle tests are added to it
+         * @return true if a triangle is hit
+         */
+        [[nodiscard]] bool occluded(const LocalRay &ray, float maxDistance,
+                                    TraversalCounters *counters = nullptr) const;
+
+        /**
+         * Find the closest intersections of the selected rays of a packet with the mesh. Packets always traverse the
+         * binary hierarchy, a node is tested against all rays at once instead of its children against one ray.
+         * @param packet rays in local object space, the distance and primitive of rays hitting a closer triangle are
+         * updated
+         * @param mask selected rays
+         */
+        void intersectPacket(RayPacket &packet, uint64_t mask) const;
     };
 }
\ No newline at end of file
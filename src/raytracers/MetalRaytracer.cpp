@@ -261,57 +261,37 @@ namespace RayTracing {
                 vertices.push_back(vertex.toMetal());
             }
 
-            // transform nested bounding boxes into metal format (flattened)
-            NestedBoundingBox rootBoundingBox = *(object->nestedBoundingBox);
-            std::vector toTraverse = {object->nestedBoundingBox};
-            unsigned long newTotalTriangleCount = 0;
-            while (!toTraverse.empty()) {
-                // pop front
-                auto current = toTraverse.front();
-                toTraverse.erase(toTraverse.begin());
-
-                auto currentMetal = current->toMetalBasic();
-
-                // get child bounding boxes, add them to the traversal and set the indices in the parent
-                int leftTreeDepth = 0;
-                if (current->left != nullptr) {
-                    toTraverse.push_back(current->left);
-                    currentMetal.childLeftIndex = (int) nestedBoundingBoxes.size() + 1;
-                    leftTreeDepth = (int) current->left->totalNodeCount();
-                } else {
+            // transform the linear bounding volume hierarchy into metal format, child indices become absolute
+            const LinearBVH &bvh = *object->linearBVH;
+            const unsigned nodeOffset = nestedBoundingBoxes.size();
+            const unsigned objectIndicesOffset = indices.size();
+            const unsigned objectNormalsOffset = normals.size();
+            for (unsigned i = 0; i < bvh.nodes.size(); i++) {
+                const auto &node = bvh.nodes[i];
+                auto currentMetal = node.bounds.toMetalBasic();
+                if (node.isLeaf()) {
                     currentMetal.childLeftIndex = -1;
-                }
-                if (current->right != nullptr) {
-                    toTraverse.push_back(current->right);
-                    currentMetal.childRightIndex = (int) nestedBoundingBoxes.size() + leftTreeDepth + 1;
-                } else {
                     currentMetal.childRightIndex = -1;
-                }
-
-                // set offsets for indices and normals, and copy them
-                if (!current->indices.empty()) {
-                    currentMetal.indicesOffset = (int) indices.size();
-                    currentMetal.normalsOffset = (int) normals.size();
-                    currentMetal.triangleCount = current->indices.size() / 3;
-                    newTotalTriangleCount += currentMetal.triangleCount;
-                    indices.insert(indices.end(), current->indices.begin(), current->indices.end());
-                    std::ranges::transform(current->normals, std::back_inserter(normals),
-                                           [](const Vec3 &n) {
-                                               return n.toMetal();
-                                           });
+                    currentMetal.indicesOffset = (int) (objectIndicesOffset + node.trianglesOffset * 3);
+                    currentMetal.normalsOffset = (int) (objectNormalsOffset + node.trianglesOffset);
+                    currentMetal.triangleCount = node.triangleCount;
                 } else {
+                    currentMetal.childLeftIndex = (int) (nodeOffset + i + 1);
+                    currentMetal.childRightIndex = (int) (nodeOffset + node.secondChildOffset);
                     currentMetal.indicesOffset = -1;
                     currentMetal.normalsOffset = -1;
                     currentMetal.triangleCount = 0;
-                    // currentMetal.indicesOffset = (int) indices.size();
-                    // currentMetal.normalsOffset = (int) normals.size();
-                    // currentMetal.triangleCount = object->mesh->numTriangles;
                 }
                 nestedBoundingBoxes.push_back(currentMetal);
             }
+            // the triangles of the mesh are already in leaf order
+            indices.insert(indices.end(), object->mesh->indices.begin(), object->mesh->indices.end());
+            std::ranges::transform(object->mesh->normals, std::back_inserter(normals), [](const Vec3 &n) {
+                return n.toMetal();
+            });
 
             // for legacy single hitbox rendering
-            metalObject.triangleCount = newTotalTriangleCount;
+            metalObject.triangleCount = object->mesh->numTriangles;
             meshObjects.push_back(metalObject);
         }
         return {
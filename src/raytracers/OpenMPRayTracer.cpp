@@ -1,141 +1,240 @@
 #include "OpenMPRayTracer.hpp"
 #include "../timing.hpp"
+#include "SFML/System/Vector2.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <numeric>
+#include <random>
 
 namespace RayTracing {
     OpenMPRayTracer::OpenMPRayTracer(const Vec2u &windowSize, unsigned bounces, unsigned samplesPerPixel)
         : SequentialRayTracer(windowSize, bounces, samplesPerPixel) {
     }
 
+    OpenMPRayTracer::~OpenMPRayTracer() {
+        delete pool;
+    }
+
+    ThreadPool &OpenMPRayTracer::threadPool(unsigned threads) {
+        if (pool == nullptr || threads != poolThreads) {
+            delete pool;
+            pool = new ThreadPool(threads);
+            poolThreads = threads;
+        }
+        return *pool;
+    }
+
     Image *OpenMPRayTracer::raytrace(Scene scene) {
         TIMING_START(prepping)
         auto *image = new Image(getWindowSize());
         scene.prepareRender();
+        threadPool(getRenderSettings().threads);
         TIMING_END(prepping)
         TIMING_LOG(prepping, RaytracingTimer::Component::SCENE_LOADING, "prepping scene for raytracing")
         TIMING_START(rays)
-        auto rays = calculateStartingRays(scene.camera);
+        const CameraRayGenerator cameraRays = cameraRayGenerator(scene.camera);
+        const std::vector<Vec2u> pixelOrder = mortonTileOrder(clampedTileSize());
         TIMING_END(rays)
-        TIMING_LOG(rays, RaytracingTimer::Component::ENCODING, "calculating starting rays")
+        TIMING_LOG(rays, RaytracingTimer::Component::ENCODING, "preparing camera ray generation")
         std::cout << "[" << identifier() << "] Starting raytrace with "
                 << getRayCount() << " rays, "
                 << scene.objects.size() << " mesh objects (" << scene.getTriangleCount() << " triangles), "
                 << scene.spheres.size() << " spheres and "
-                << scene.lights.size() << " light sources"
+                << scene.lights.size() << " light sources on "
+                << pool->threadCount() << " threads"
                 << std::endl;
         std::cout << "[" << identifier() << "]" << " Maximum nested bounding box depth: " << scene.getNestingDepth() <<
                 std::endl;
 
         TIMING_START(tracing)
-        long iteration = 0;
-        double progress = 0.0;
-#pragma omp parallel for schedule(dynamic)
-        for (auto &ray: rays) {
-            for (unsigned b = 0; b < getBounces(); b++) {
-                HitInfo currentHit{.hit = false, .distance = INFINITY};
-                Vec3 currentRotatedNormal;
-                RGBf currentColor;
-                float currentSpecularIntensity = 0.0f;
-
-                // check collision with complex objects
-                for (const auto object: scene.objects) {
-                    auto localRay = ray.toLocalRay(object->transform);
-
-                    if (!localRay.intersectsBoundingBox(object->boundingBox)) {
-                        continue;
-                    }
-
-                    std::vector<int> indices; //= object->mesh->indices;
-                    std::vector<NestedBoundingBox *> boxesToCheck;
-                    boxesToCheck.push_back(object->nestedBoundingBox);
-                    while (!boxesToCheck.empty()) {
-                        auto nestedBox = boxesToCheck.back();
-                        boxesToCheck.pop_back();
-                        if (!nestedBox->indices.empty()) {
-                            indices.insert(indices.end(), nestedBox->indices.begin(), nestedBox->indices.end());
-                            continue;
-                        }
-                        if (nestedBox->left != nullptr && localRay.intersectsBoundingBox(*nestedBox->left)) {
-                            boxesToCheck.push_back(nestedBox->left);
-                        }
-                        if (nestedBox->right != nullptr && localRay.intersectsBoundingBox(*nestedBox->right)) {
-                            boxesToCheck.push_back(nestedBox->right);
-                        }
-                    }
+        // the rays of a tile are only kept by the thread rendering it
+        std::vector<std::vector<Ray> > threadRays(pool->threadCount());
+        std::vector<std::chrono::high_resolution_clock::duration> threadResolveTimes(pool->threadCount());
+        forEachTile([&](const Vec2u &tileStart, unsigned thread) {
+            renderTile(scene, cameraRays, pixelOrder, tileStart, threadRays[thread], threadResolveTimes[thread], image);
+        });
+        TIMING_END(tracing)
+        // the tiles are resolved while tracing, the share of the threads' time spent resolving is logged as decoding
+        const auto resolveMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::accumulate(threadResolveTimes.begin(), threadResolveTimes.end(),
+                            std::chrono::high_resolution_clock::duration::zero()) / pool->threadCount()).count();
+        RaytracingTimer::getInstance()->logDuration(this, RaytracingTimer::Component::RAYTRACING,
+                                                    TIMING_MILLIS(tracing) - resolveMillis, "tracing rays");
+        RaytracingTimer::getInstance()->logDuration(this, RaytracingTimer::Component::DECODING, resolveMillis,
+                                                    "resolving rays into image");
 
-                    if (indices.empty()) continue;
-
-                    for (int i = 0; i < indices.size() / 3; i++) {
-                        int *startIndex = &indices[i * 3];
-                        Vec3 triangle[3] = {
-                            object->mesh->vertices[startIndex[0]],
-                            object->mesh->vertices[startIndex[1]],
-                            object->mesh->vertices[startIndex[2]]
-                        };
-                        auto intersection = localRay.intersectTriangle(triangle, object->mesh->normals[i]);
-                        if (intersection.hit && intersection.distance < currentHit.distance) {
-                            currentHit = intersection;
-                            currentRotatedNormal = object->transform.getTransformedNormal(intersection.normal);
-                            currentColor = object->color;
-                            currentSpecularIntensity = object->specularIntensity;
-                        }
-                    }
-                }
+        return image;
+    }
 
-                // check collision for spheres
-                for (const auto sphere: scene.spheres) {
-                    auto intersection = ray.intersectSphere(sphere->transform.getTranslation(), sphere->radius);
-                    if (intersection.hit && intersection.distance < currentHit.distance) {
-                        currentHit = intersection;
-                        currentRotatedNormal = intersection.normal;
-                        currentColor = sphere->color;
-                        currentSpecularIntensity = sphere->specularIntensity;
+    void OpenMPRayTracer::tracePass(const Scene &scene, AccumulationBuffer &accumulation, unsigned sample) {
+        threadPool(getRenderSettings().threads);
+        const CameraRayGenerator cameraRays = cameraRayGenerator(scene.camera);
+        const unsigned tileSize = clampedTileSize();
+        forEachTile([&](const Vec2u &tileStart, unsigned) {
+            // seeded by tile and pass, so the passes do not depend on the thread rendering a tile either
+            std::seed_seq seed{tileStart.getY() * getWindowSize().getX() + tileStart.getX(), sample};
+            std::mt19937 rng(seed);
+            const unsigned tileEndX = std::min(tileStart.getX() + tileSize, getWindowSize().getX());
+            const unsigned tileEndY = std::min(tileStart.getY() + tileSize, getWindowSize().getY());
+            for (unsigned y = tileStart.getY(); y < tileEndY; y++) {
+                for (unsigned x = tileStart.getX(); x < tileEndX; x++) {
+                    if (accumulation.isConverged(x, y)) {
+                        continue;
                     }
+                    Ray ray = cameraRays.generate(x, y, sample % getSamplesPerPixel());
+                    ray.rngSeed = Vec3::random(rng);
+                    traceRay(scene, ray);
+                    accumulation.add(x, y, pathColor(ray));
                 }
+            }
+        });
+    }
 
-                // check collision for light sources
-                for (const auto &light: scene.lights) {
-                    auto intersection = ray.intersectSphere(light->transform.getTranslation(), light->radius);
-                    if (intersection.hit && intersection.distance < currentHit.distance) {
-                        currentHit = intersection;
-                        currentHit.isLight = true;
-                        currentRotatedNormal = {};
-                        currentColor = light->emittingColor;
-                    }
-                }
+    Image *OpenMPRayTracer::uvTest() {
+        const Vec2u windowSize = getWindowSize();
+        auto *image = new Image(windowSize);
+        threadPool(getRenderSettings().threads).parallelFor(windowSize.getY(), [&](unsigned y, unsigned) {
+            for (unsigned x = 0; x < windowSize.getX(); x++) {
+                sf::Vector2 uv = {x / (double) windowSize.getX(), y / (double) windowSize.getY()};
+                image->setPixel(x, y, {uv.x * 255, uv.y * 255, 0});
+            }
+        });
+        return image;
+    }
 
-                if (currentHit.hit) {
-                    // hacky way to get some shading without light sources
-                    if (currentHit.isLight) {
-                        ray.lightColor = currentColor;
-                        b = getBounces(); // after ray intersects with light source, stop bouncing
-                    } else {
-                        ray.colors.emplace_back(currentColor);
+    Image *OpenMPRayTracer::rayTest(Camera *camera) {
+        auto *image = new Image(getWindowSize());
+        const CameraRayGenerator cameraRays = cameraRayGenerator(camera);
+        const unsigned samples = getSamplesPerPixel();
+        const unsigned tileSize = clampedTileSize();
+        threadPool(getRenderSettings().threads);
+        forEachTile([&](const Vec2u &tileStart, unsigned) {
+            std::vector<RGBf> sampleColors(samples);
+            const unsigned tileEndX = std::min(tileStart.getX() + tileSize, getWindowSize().getX());
+            const unsigned tileEndY = std::min(tileStart.getY() + tileSize, getWindowSize().getY());
+            for (unsigned y = tileStart.getY(); y < tileEndY; y++) {
+                for (unsigned x = tileStart.getX(); x < tileEndX; x++) {
+                    for (unsigned s = 0; s < samples; s++) {
+                        auto dot = cameraRays.generate(x, y, s).direction.dot(Vec3::forward());
+                        dot = dot * dot * dot * dot;
+                        sampleColors[s] = RGBf(dot, dot, dot, 1);
                     }
-                    ray.reflectAt(currentHit.hitPoint - ray.direction * 0.1f, currentRotatedNormal,
-                                  currentSpecularIntensity);
-                    ray.totalDistance += currentHit.distance;
-                } else {
-                    b = getBounces(); // no hit, stop bouncing
+                    image->setPixel(x, y, RGBf::blend(sampleColors));
                 }
             }
-            iteration++;
-            progress = iteration / (static_cast<double>(rays.size()));
-            if (iteration % 1000 == 0) {
-                std::cout << "\r" << iteration << "/" << rays.size() << " rays traced (" << (progress * 100.0) << "%)"
+        });
+        return image;
+    }
+
+    void OpenMPRayTracer::forEachTile(const std::function<void(const Vec2u &tileStart, unsigned thread)> &task) {
+        const unsigned tileSize = clampedTileSize();
+        const unsigned tilesX = (getWindowSize().getX() + tileSize - 1) / tileSize;
+        const unsigned tilesY = (getWindowSize().getY() + tileSize - 1) / tileSize;
+        const unsigned tileCount = tilesX * tilesY;
+        std::atomic<unsigned> tilesDone{0};
+        pool->parallelFor(tileCount, [&](unsigned tile, unsigned thread) {
+            task({tile % tilesX * tileSize, tile / tilesX * tileSize}, thread);
+            unsigned done = tilesDone.fetch_add(1, std::memory_order_relaxed) + 1;
+            // only the calling thread writes the progress, the others would interleave their output with it
+            if (thread == 0) {
+                std::cout << "\r" << done << "/" << tileCount << " tiles traced (" << 100.0 * done / tileCount << "%)"
                         << std::flush;
             }
-        }
+        });
         std::cout << '\r';
-        TIMING_END(tracing)
-        TIMING_LOG(tracing, RaytracingTimer::Component::RAYTRACING, "tracing rays")
+    }
 
-        TIMING_START(resolve)
-        resolveRays(image, rays);
-        TIMING_END(resolve)
-        TIMING_LOG(resolve, RaytracingTimer::Component::DECODING, "resolving rays into image")
+    unsigned OpenMPRayTracer::clampedTileSize() const {
+        const Vec2u windowSize = getWindowSize();
+        return std::min(getRenderSettings().tileSize, std::max(windowSize.getX(), windowSize.getY()));
+    }
 
-        return image;
+    std::vector<Vec2u> OpenMPRayTracer::mortonTileOrder(unsigned size) {
+        const unsigned codeSize = std::bit_ceil(size);
+        std::vector<Vec2u> order;
+        order.reserve(size * size);
+        for (uint64_t code = 0; code < (uint64_t) codeSize * codeSize; code++) {
+            // even bits of the code are the x coordinate, odd bits the y coordinate
+            unsigned x = 0;
+            unsigned y = 0;
+            for (unsigned bit = 0; 1u << bit < codeSize; bit++) {
+                x |= (unsigned) (code >> (2 * bit) & 1) << bit;
+                y |= (unsigned) (code >> (2 * bit + 1) & 1) << bit;
+            }
+            if (x < size && y < size) {
+                order.emplace_back(x, y);
+            }
+        }
+        return order;
+    }
+
+    void OpenMPRayTracer::renderTile(const Scene &scene, const CameraRayGenerator &cameraRays,
+                                     const std::vector<Vec2u> &pixelOrder, const Vec2u &tileStart,
+                                     std::vector<Ray> &rays,
+                                     std::chrono::high_resolution_clock::duration &resolveTime, Image *image) const {
+        const Vec2u windowSize = getWindowSize();
+        const unsigned samples = getSamplesPerPixel();
+        const unsigned tileSize = clampedTileSize();
+        const unsigned tileWidth = std::min(tileSize, windowSize.getX() - tileStart.getX());
+        const unsigned tileHeight = std::min(tileSize, windowSize.getY() - tileStart.getY());
+
+        // the seeds only depend on the tile, so the image does not depend on which thread renders it
+        std::mt19937 rng(tileStart.getY() * windowSize.getX() + tileStart.getX());
+        rays.clear();
+        for (const Vec2u &offset: pixelOrder) {
+            if (offset.getX() >= tileWidth || offset.getY() >= tileHeight) {
+                continue;
+            }
+            for (unsigned s = 0; s < samples; s++) {
+                rays.push_back(cameraRays.generate(tileStart.getX() + offset.getX(), tileStart.getY() + offset.getY(),
+                                                   s));
+                rays.back().rngSeed = Vec3::random(rng);
+            }
+        }
+
+        const unsigned packetSize = getRenderSettings().rayPacketSize;
+        if (packetSize > 0) {
+            // pixels are in Morton order, so the rays of every aligned block of packetSize x packetSize pixels of the
+            // tile are contiguous for any tile size. Blocks clipped by the tile or image border have fewer rays.
+            std::vector<unsigned> rayIndices(rays.size());
+            std::iota(rayIndices.begin(), rayIndices.end(), 0);
+            auto blockOf = [&](const Ray &ray) {
+                return (ray.idY - tileStart.getY()) / packetSize * tileSize + (ray.idX - tileStart.getX()) / packetSize;
+            };
+            for (unsigned block = 0, blockEnd; block < rays.size(); block = blockEnd) {
+                blockEnd = block + 1;
+                while (blockEnd < rays.size() && blockOf(rays[blockEnd]) == blockOf(rays[block])) {
+                    blockEnd++;
+                }
+                for (unsigned start = block; start < blockEnd; start += RayPacket::MAX_SIZE) {
+                    tracePacket(scene, rays, &rayIndices[start], std::min(RayPacket::MAX_SIZE, blockEnd - start));
+                }
+            }
+        } else {
+            for (auto &ray: rays) {
+                traceRay(scene, ray);
+            }
+        }
+
+        // resolve into a buffer of the tile first, the image rows are only written once per tile
+        const auto resolveStart = std::chrono::high_resolution_clock::now();
+        std::vector<RGBA8> pixels(tileWidth * tileHeight);
+        std::vector<RGBf> sampleColors(samples);
+        for (unsigned pixel = 0; pixel < rays.size(); pixel += samples) {
+            for (unsigned s = 0; s < samples; s++) {
+                sampleColors[s] = pathColor(rays[pixel + s]);
+            }
+            const Ray &ray = rays[pixel];
+            pixels[(ray.idY - tileStart.getY()) * tileWidth + ray.idX - tileStart.getX()] =
+                    RGBf::blend(sampleColors).toRGBA8();
+        }
+        for (unsigned y = 0; y < tileHeight; y++) {
+            std::copy_n(&pixels[y * tileWidth], tileWidth, &(*image)[tileStart.getX(), tileStart.getY() + y]);
+        }
+        resolveTime += std::chrono::high_resolution_clock::now() - resolveStart;
     }
-}
\ No newline at end of file
+}
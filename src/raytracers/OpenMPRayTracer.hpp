@@ -1,12 +1,67 @@
 #pragma once
+#include <chrono>
+
 #include "SequentialRayTracer.hpp"
+#include "../ThreadPool.hpp"
 
 namespace RayTracing {
-    /// Raytracer implementation using OpenMP for parallelization on CPU
+    /**
+     * Multi-threaded raytracer implementation on the CPU.
+     * The image is rendered in tiles distributed by a work stealing thread pool: a thread generates the camera rays
+     * of a tile, traces them and resolves the pixels into a buffer of its own before copying them into the image, so
+     * only the rays of the tiles in flight are stored instead of the rays of the whole image. The pool is kept
+     * between renders.
+     */
     class OpenMPRayTracer : public SequentialRayTracer {
+    private:
+        /// threads rendering the tiles, recreated if the requested thread count changes
+        ThreadPool *pool = nullptr;
+        /// number of threads requested for pool, 0 for all hardware threads
+        unsigned poolThreads = 0;
+
+        /// Get the thread pool with the requested number of threads, it is only created again if the count changed
+        ThreadPool &threadPool(unsigned threads);
+
+        /**
+         * Get the width and height of the tiles, the requested tile size is clamped to the image size so the pixel
+         * order of a tile never covers more than the image
+         * @return tile size in pixels
+         */
+        unsigned clampedTileSize() const;
+
+        /**
+         * Get the pixel offsets of a tile in Morton order, so every aligned 4x4 and 8x8 pixel block of the tile is
+         * contiguous
+         * @param size width and height of the tile
+         * @return size * size offsets inside of the tile
+         */
+        static std::vector<Vec2u> mortonTileOrder(unsigned size);
+
+        /**
+         * Run a task for every tile of the image on the thread pool and print the progress
+         * @param task called with the position of the upper left pixel of the tile and the thread running it
+         */
+        void forEachTile(const std::function<void(const Vec2u &tileStart, unsigned thread)> &task);
+
+        /**
+         * Generate, trace and resolve the camera rays of a tile
+         * @param scene prepared scene to trace
+         * @param cameraRays generator of the camera rays
+         * @param pixelOrder offsets of the pixels inside of the tile in tracing order
+         * @param tileStart position of the upper left pixel of the tile, also seeds the random numbers of its rays
+         * @param rays buffer for the rays of the tile, reused between tiles
+         * @param resolveTime time spent resolving the rays into the image, the time of this tile is added
+         * @param image image the pixels of the tile are written to
+         */
+        void renderTile(const Scene &scene, const CameraRayGenerator &cameraRays, const std::vector<Vec2u> &pixelOrder,
+                        const Vec2u &tileStart, std::vector<Ray> &rays,
+                        std::chrono::high_resolution_clock::duration &resolveTime, Image *image) const;
+
     public:
         OpenMPRayTracer(const Vec2u &windowSize, unsigned bounces, unsigned samplesPerPixel);
 
+        ~OpenMPRayTracer() override;
+
         /**
          * Raytrace a scene and generate image
          * @param scene scene to raytrace
@@ -14,6 +69,29 @@ namespace RayTracing {
          */
         Image *raytrace(Scene scene) override;
 
+        /**
+         * Trace one sample of every pixel that is not converged yet through all bounces and add its color to an
+         * accumulation buffer, the tiles are distributed to the thread pool like in raytrace
+         * @param scene prepared scene
+         * @param accumulation buffer of the size of the window
+         * @param sample index of the pass, selects the sampling offset inside of the pixels and seeds the random
+         * numbers of the rays
+         */
+        void tracePass(const Scene &scene, AccumulationBuffer &accumulation, unsigned sample) override;
+
+        /**
+         * Simple UV Space image test, used to test basic compute pipeline
+         * @return uv image
+         */
+        Image *uvTest() override;
+
+        /**
+         * Simple ray test to check ray generation
+         * @param camera camera to generate rays from
+         * @return image with ray directions encoded as colors
+         */
+        Image *rayTest(Camera *camera) override;
+
         /// Get the identifier of the raytracer
         std::string identifier() override {
             return "OpenMPRayTracer";
@@ -4,6 +4,7 @@
 #include "MetalRaytracer.hpp"
 #include "OpenMPRayTracer.hpp"
 #include "SequentialRayTracer.hpp"
+#include "WavefrontRayTracer.hpp"
 
 namespace RayTracing {
     RayTracerFactory *RayTracerFactory::instance = nullptr;
@@ -29,6 +30,8 @@ namespace RayTracing {
 
         this->multiThreadedRayTracer = new OpenMPRayTracer(windowSize, bounces, samplesPerPixel);
 
+        this->wavefrontRayTracer = new WavefrontRayTracer(windowSize, bounces, samplesPerPixel);
+
 #ifdef USE_SHADER_METAL
         this->shaderRayTracer = new MetalRaytracer(windowSize, bounces, samplesPerPixel);
 #endif
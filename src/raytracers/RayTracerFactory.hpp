@@ -5,7 +5,8 @@ namespace RayTracing {
     enum RayTracerType {
         SEQUENTIAL,
         MULTI_THREADED,
-        SHADER_BASED
+        SHADER_BASED,
+        WAVEFRONT
     };
 
     /// Factory class to create and manage different RayTracer implementations
@@ -16,6 +17,7 @@ namespace RayTracing {
         RayTracer *sequentialRayTracer = nullptr;
         RayTracer *multiThreadedRayTracer = nullptr;
         RayTracer *shaderRayTracer = nullptr;
+        RayTracer *wavefrontRayTracer = nullptr;
 
         RayTracerFactory(const Vec2u &windowSize, unsigned bounces, unsigned samplesPerPixel);
 
@@ -43,6 +45,9 @@ namespace RayTracing {
         /// get the supported GPU raytracer
         RayTracer *getShaderImplementation() { return shaderRayTracer; }
 
+        /// get the CPU raytracer processing the image bounce by bounce
+        RayTracer *getWavefrontImplementation() { return wavefrontRayTracer; }
+
         RayTracer *getRayTracerByType(RayTracerType type) {
             switch (type) {
                 case SEQUENTIAL:
@@ -51,6 +56,8 @@ namespace RayTracing {
                     return getMultiThreadedImplementation();
                 case SHADER_BASED:
                     return getShaderImplementation();
+                case WAVEFRONT:
+                    return getWavefrontImplementation();
                 default:
                     return nullptr;
             }
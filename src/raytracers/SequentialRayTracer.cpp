@@ -1,7 +1,10 @@
 #include "SequentialRayTracer.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <future>
 #include <iostream>
+#include <random>
 
 #include "../Renderer.h"
 #include "../timing.hpp"
@@ -50,100 +53,28 @@ namespace RayTracing {
         TIMING_START(tracing)
         long iteration = 0;
         double progress = 0.0;
-        for (auto &ray: rays) {
-            for (unsigned b = 0; b < getBounces(); b++) {
-                HitInfo currentHit{.hit = false, .distance = INFINITY};
-                Vec3 currentRotatedNormal;
-                RGBf currentColor;
-                float currentSpecularIntensity = 0.0f;
-
-                // check collision with complex objects
-                for (const auto object: scene.objects) {
-                    auto localRay = ray.toLocalRay(object->transform);
-
-                    if (!localRay.intersectsBoundingBox(object->boundingBox)) {
-                        continue;
-                    }
-
-                    std::vector<int> indices = object->mesh->indices;
-                    /*std::vector<NestedBoundingBox *> boxesToCheck;
-                    boxesToCheck.push_back(object->nestedBoundingBox);
-                    while (!boxesToCheck.empty()) {
-                        auto nestedBox = boxesToCheck.back();
-                        boxesToCheck.pop_back();
-                        if (!nestedBox->indices.empty()) {
-                            indices.insert(indices.end(), nestedBox->indices.begin(), nestedBox->indices.end());
-                            continue;
-                        }
-                        if (nestedBox->left != nullptr && localRay.intersectsBoundingBox(*nestedBox->left)) {
-                            boxesToCheck.push_back(nestedBox->left);
-                        }
-                        if (nestedBox->right != nullptr && localRay.intersectsBoundingBox(*nestedBox->right)) {
-                            boxesToCheck.push_back(nestedBox->right);
-                        }
-                    }*/
-
-                    if (indices.empty()) continue;
-
-                    for (int i = 0; i < indices.size() / 3; i++) {
-                        int *startIndex = &indices[i * 3];
-                        Vec3 triangle[3] = {
-                            object->mesh->vertices[startIndex[0]],
-                            object->mesh->vertices[startIndex[1]],
-                            object->mesh->vertices[startIndex[2]]
-                        };
-                        auto intersection = localRay.intersectTriangle(triangle, object->mesh->normals[i]);
-                        if (intersection.hit && intersection.distance < currentHit.distance) {
-                            currentHit = intersection;
-                            currentRotatedNormal = object->transform.getTransformedNormal(intersection.normal);
-                            currentColor = object->color;
-                            currentSpecularIntensity = object->specularIntensity;
-                        }
-                    }
-                }
-
-                // check collision for spheres
-                for (const auto sphere: scene.spheres) {
-                    auto intersection = ray.intersectSphere(sphere->transform.getTranslation(), sphere->radius);
-                    if (intersection.hit && intersection.distance < currentHit.distance) {
-                        currentHit = intersection;
-                        currentRotatedNormal = intersection.normal;
-                        currentColor = sphere->color;
-                        currentSpecularIntensity = sphere->specularIntensity;
-                    }
-                }
-
-                // check collision for light sources
-                for (const auto &light: scene.lights) {
-                    auto intersection = ray.intersectSphere(light->transform.getTranslation(), light->radius);
-                    if (intersection.hit && intersection.distance < currentHit.distance) {
-                        currentHit = intersection;
-                        currentHit.isLight = true;
-                        currentRotatedNormal = {};
-                        currentColor = light->emittingColor;
-                    }
-                }
-
-                if (currentHit.hit) {
-                    // hacky way to get some shading without light sources
-                    if (currentHit.isLight) {
-                        ray.lightColor = currentColor;
-                        b = getBounces(); // after ray intersects with light source, stop bouncing
-                    } else {
-                        ray.colors.emplace_back(currentColor);
-                    }
-                    ray.reflectAt(currentHit.hitPoint - ray.direction * 0.1f, currentRotatedNormal,
-                                  currentSpecularIntensity);
-                    ray.totalDistance += currentHit.distance;
-                } else {
-                    b = getBounces(); // no hit, stop bouncing
+        if (getRenderSettings().rayPacketSize > 0) {
+            std::vector<unsigned> rayIndices;
+            std::vector<unsigned> packetStarts = groupRayPackets(getRenderSettings().rayPacketSize, rayIndices);
+            for (size_t packet = 0; packet + 1 < packetStarts.size(); packet++) {
+                unsigned count = packetStarts[packet + 1] - packetStarts[packet];
+                tracePacket(scene, rays, &rayIndices[packetStarts[packet]], count);
+                iteration += count;
+                progress = (double) iteration / (static_cast<double>(rays.size()));
+                if (packet % 64 == 63) {
+                    std::cout << "\r" << iteration << "/" << rays.size() << " rays traced (" << (progress * 100.0) <<
+                            "%)" << std::flush;
                 }
             }
-            iteration++;
-            progress = (double) iteration / (static_cast<double>(rays.size()));
-            if (iteration % 1000 == 0) {
-                std::cout << "\r" << iteration << "/" << rays.size() << " rays traced (" << (progress * 100.0) << "%)"
-                        << std::flush;
+        } else {
+            for (auto &ray: rays) {
+                traceRay(scene, ray);
+                iteration++;
+                progress = (double) iteration / (static_cast<double>(rays.size()));
+                if (iteration % 1000 == 0) {
+                    std::cout << "\r" << iteration << "/" << rays.size() << " rays traced (" << (progress * 100.0) <<
+                            "%)" << std::flush;
+                }
             }
         }
         std::cout << '\r';
@@ -158,6 +89,227 @@ namespace RayTracing {
         return image;
     }
 
+    void SequentialRayTracer::keepMeshHit(const MeshedRayTraceableObject &object, const Ray &ray,
+                                          const HitInfo &intersection, SurfaceHit &closest) {
+        if (intersection.hit && intersection.distance < closest.hit.distance) {
+            closest.hit = intersection;
+            // the ray parameter is the same in local and world space, but the hit point has to be in world space
+            closest.hit.hitPoint = ray.origin + ray.direction * intersection.distance;
+            closest.normal = object.transform.getTransformedNormal(intersection.normal);
+            closest.color = object.color;
+            closest.specularIntensity = object.specularIntensity;
+        }
+    }
+
+    void SequentialRayTracer::intersectInstance(const Scene &scene, const TopLevelInstance &instance, const Ray &ray,
+                                                SurfaceHit &closest, BVHStatistics *statistics) {
+        switch (instance.type) {
+            case TopLevelInstance::Type::MESH: {
+                const auto object = scene.objects[instance.index];
+                auto localRay = ray.toLocalRay(object->transform);
+                auto intersection = object->intersect(
+                    localRay, statistics != nullptr ? &statistics->meshes[instance.index].traversal : nullptr);
+                keepMeshHit(*object, ray, intersection, closest);
+                break;
+            }
+            case TopLevelInstance::Type::SPHERES: {
+                const SphereBlocks &blocks = scene.topLevelBVH.sphereBlocks;
+                HitInfo intersection;
+                int lane = blocks.intersect(ray, instance.index, closest.hit.distance, intersection);
+                if (lane < 0) {
+                    break;
+                }
+                closest.hit = intersection;
+                uint32_t object = blocks[instance.index].object[lane];
+                if ((blocks[instance.index].lightMask >> lane) & 1) {
+                    const auto light = scene.lights[object];
+                    closest.hit.isLight = true;
+                    closest.normal = {};
+                    closest.color = light->emittingColor;
+                    closest.specularIntensity = 0.0f;
+                } else {
+                    const auto sphere = scene.spheres[object];
+                    closest.normal = intersection.normal;
+                    closest.color = sphere->color;
+                    closest.specularIntensity = sphere->specularIntensity;
+                }
+                break;
+            }
+        }
+    }
+
+    SequentialRayTracer::SurfaceHit SequentialRayTracer::findClosestHit(const Scene &scene, const Ray &ray,
+                                                                        BVHStatistics *statistics) {
+        SurfaceHit closest;
+        scene.topLevelBVH.traverse(ray, closest.hit.distance, [&](const TopLevelInstance &instance) {
+            intersectInstance(scene, instance, ray, closest, statistics);
+        }, statistics != nullptr ? &statistics->topLevel : nullptr);
+        return closest;
+    }
+
+    bool SequentialRayTracer::occluded(const Scene &scene, const Ray &ray, float maxDistance,
+                                       BVHStatistics *statistics) {
+        return scene.topLevelBVH.traverseUntil(ray, maxDistance, [&](const TopLevelInstance &instance) {
+            switch (instance.type) {
+                case TopLevelInstance::Type::MESH: {
+                    const auto object = scene.objects[instance.index];
+                    return object->occluded(ray.toLocalRay(object->transform), maxDistance,
+                                            statistics != nullptr ? &statistics->meshes[instance.index].traversal
+                                                                  : nullptr);
+                }
+                case TopLevelInstance::Type::SPHERES:
+                    return scene.topLevelBVH.sphereBlocks.occluded(ray, instance.index, maxDistance);
+                default:
+                    return false;
+            }
+        }, statistics != nullptr ? &statistics->topLevel : nullptr);
+    }
+
+    void SequentialRayTracer::occluded(const Scene &scene, const std::vector<Ray> &rays,
+                                       const std::vector<float> &maxDistances, std::vector<uint8_t> &result) {
+        result.resize(rays.size());
+#pragma omp parallel for schedule(dynamic, 256)
+        for (size_t i = 0; i < rays.size(); i++) {
+            result[i] = occluded(scene, rays[i], maxDistances[i]);
+        }
+    }
+
+    void SequentialRayTracer::findClosestHits(const Scene &scene, RayPacket &packet, SurfaceHit *hits) {
+        for (unsigned i = 0; i < packet.size; i++) {
+            hits[i] = SurfaceHit{};
+        }
+        scene.topLevelBVH.traversePacket(packet, packet.fullMask(), [&](const TopLevelInstance &instance,
+                                                                        uint64_t mask) {
+            if (instance.type != TopLevelInstance::Type::MESH) {
+                for (uint64_t rays = mask; rays != 0; rays &= rays - 1) {
+                    unsigned i = std::countr_zero(rays);
+                    intersectInstance(scene, instance, packet.getRay(i), hits[i]);
+                    packet.maxDistance[i] = hits[i].hit.distance;
+                }
+                return;
+            }
+
+            const auto object = scene.objects[instance.index];
+            RayPacket localPacket;
+            localPacket.size = packet.size;
+            for (uint64_t rays = mask; rays != 0; rays &= rays - 1) {
+                unsigned i = std::countr_zero(rays);
+                localPacket.setRay(i, packet.getRay(i).toLocalRay(object->transform), packet.maxDistance[i]);
+            }
+            localPacket.updateBounds(mask);
+            object->intersectPacket(localPacket, mask);
+            for (uint64_t rays = mask; rays != 0; rays &= rays - 1) {
+                unsigned i = std::countr_zero(rays);
+                if (localPacket.primitive[i] == RayPacket::NO_PRIMITIVE) {
+                    continue;
+                }
+                float distance = localPacket.maxDistance[i];
+                // the hit point is recalculated in world space
+                HitInfo intersection{
+                    .hit = true, .normal = object->mesh->normals[localPacket.primitive[i]], .distance = distance
+                };
+                keepMeshHit(*object, packet.getRay(i), intersection, hits[i]);
+                packet.maxDistance[i] = hits[i].hit.distance;
+            }
+        });
+    }
+
+    bool SequentialRayTracer::bounceAt(Ray &ray, const SurfaceHit &hit) {
+        if (!hit.hit.hit) {
+            return false; // no hit, stop bouncing
+        }
+
+        // hacky way to get some shading without light sources
+        if (hit.hit.isLight) {
+            ray.lightColor = hit.color;
+        } else {
+            ray.throughput *= hit.color;
+            ray.surfaceHits++;
+        }
+        ray.reflectAt(hit.hit.hitPoint - ray.direction * 0.1f, hit.normal, hit.specularIntensity);
+        ray.totalDistance += hit.hit.distance;
+
+        // after ray intersects with light source, stop bouncing
+        return !hit.hit.isLight;
+    }
+
+    void SequentialRayTracer::traceRay(const Scene &scene, Ray &ray, BVHStatistics *statistics,
+                                       unsigned firstBounce) const {
+        for (unsigned b = firstBounce; b < getBounces(); b++) {
+            if (!bounceAt(ray, findClosestHit(scene, ray, statistics))) {
+                break;
+            }
+        }
+    }
+
+    void SequentialRayTracer::tracePacket(const Scene &scene, std::vector<Ray> &rays, const unsigned *rayIndices,
+                                          unsigned count) const {
+        RayPacket packet;
+        packet.size = count;
+        for (unsigned i = 0; i < count; i++) {
+            packet.setRay(i, rays[rayIndices[i]], INFINITY);
+        }
+        packet.updateBounds(packet.fullMask());
+
+        SurfaceHit hits[RayPacket::MAX_SIZE];
+        findClosestHits(scene, packet, hits);
+        for (unsigned i = 0; i < count; i++) {
+            Ray &ray = rays[rayIndices[i]];
+            if (bounceAt(ray, hits[i])) {
+                traceRay(scene, ray, nullptr, 1);
+            }
+        }
+    }
+
+    std::vector<unsigned> SequentialRayTracer::groupRayPackets(unsigned packetSize,
+                                                               std::vector<unsigned> &rayIndices) const {
+        const Vec2u windowSize = getWindowSize();
+        const unsigned samples = getSamplesPerPixel();
+        std::vector<unsigned> packetStarts;
+        rayIndices.clear();
+        rayIndices.reserve(getRayCount());
+        for (unsigned tileY = 0; tileY < windowSize.getY(); tileY += packetSize) {
+            for (unsigned tileX = 0; tileX < windowSize.getX(); tileX += packetSize) {
+                unsigned tileStart = rayIndices.size();
+                for (unsigned y = tileY; y < std::min(tileY + packetSize, windowSize.getY()); y++) {
+                    for (unsigned x = tileX; x < std::min(tileX + packetSize, windowSize.getX()); x++) {
+                        for (unsigned s = 0; s < samples; s++) {
+                            rayIndices.push_back((y * windowSize.getX() + x) * samples + s);
+                        }
+                    }
+                }
+                for (unsigned start = tileStart; start < rayIndices.size(); start += RayPacket::MAX_SIZE) {
+                    packetStarts.push_back(start);
+                }
+            }
+        }
+        packetStarts.push_back(rayIndices.size());
+        return packetStarts;
+    }
+
+    void SequentialRayTracer::sampleTraversal(const Scene &scene, BVHStatistics &statistics, unsigned rayStride) {
+        auto rays = calculateStartingRays(scene.camera);
+        for (size_t i = 0; i < rays.size(); i += std::max(rayStride, 1u)) {
+            traceRay(scene, rays[i], &statistics);
+        }
+    }
+
+    void SequentialRayTracer::tracePass(const Scene &scene, AccumulationBuffer &accumulation, unsigned sample) {
+        const CameraRayGenerator cameraRays = cameraRayGenerator(scene.camera);
+        std::mt19937 rng(sample);
+        for (unsigned y = 0; y < getWindowSize().getY(); y++) {
+            for (unsigned x = 0; x < getWindowSize().getX(); x++) {
+                if (accumulation.isConverged(x, y)) {
+                    continue;
+                }
+                Ray ray = cameraRays.generate(x, y, sample % getSamplesPerPixel());
+                ray.rngSeed = Vec3::random(rng);
+                traceRay(scene, ray);
+                accumulation.add(x, y, pathColor(ray));
+            }
+        }
+    }
+
     Image *SequentialRayTracer::rayTest(Camera *camera) {
         auto *image = new Image(getWindowSize());
         auto rays = calculateStartingRays(camera);
@@ -165,7 +317,8 @@ namespace RayTracing {
         for (auto &ray: rays) {
             auto dot = ray.direction.dot(Vec3::forward());
             dot = dot * dot * dot * dot;
-            ray.colors.emplace_back(dot, dot, dot, 1);
+            ray.throughput = RGBf(dot, dot, dot, 1);
+            ray.surfaceHits = 1;
             ray.lightColor = RGBf(1, 1, 1, 1);
         }
 
@@ -174,29 +327,23 @@ namespace RayTracing {
         return image;
     }
 
+    RGBf SequentialRayTracer::pathColor(const Ray &ray) {
+        if (ray.surfaceHits == 0) {
+            return ray.lightColor;
+        }
+        RGBf color = ray.throughput;
+        color *= ray.lightColor;
+        color.w() = 1.0f;
+        return color;
+    }
+
     void SequentialRayTracer::resolveRays(Image *image, std::vector<Ray> &rays, ColorBlendMode mode) const {
+        std::vector<RGBf> sampleColors(getSamplesPerPixel());
         for (unsigned x = 0; x < getWindowSize().getX(); x++) {
             for (unsigned y = 0; y < getWindowSize().getY(); y++) {
-                std::vector<RGBf> sampleColors;
-
-                unsigned startIndex = (y * getWindowSize().getX() + x) * getSamplesPerPixel();
+                size_t startIndex = ((size_t) y * getWindowSize().getX() + x) * getSamplesPerPixel();
                 for (int i = 0; i < getSamplesPerPixel(); i++) {
-                    const auto &currentRay = rays[startIndex + i];
-
-                    RGBf finalColor = RGBf(1.0);
-                    if (!currentRay.colors.empty()) {
-                        for (const auto &color: currentRay.colors) {
-                            finalColor *= color;
-                        }
-                        //finalColor = finalColor / static_cast<float>(currentRay.colors.size());
-                        finalColor *= currentRay.lightColor;
-                        //finalColor /= 2.0f;
-                        finalColor.w() = 1.0f;
-                    } else {
-                        finalColor = currentRay.lightColor;
-                    }
-
-                    sampleColors.push_back(finalColor);
+                    sampleColors[i] = pathColor(rays[startIndex + i]);
                 }
 
                 image->setPixel(x, y, RGBf::blend(sampleColors, mode));
@@ -1,11 +1,107 @@
 #pragma once
+#include "../AccumulationBuffer.hpp"
+#include "../RayPacket.hpp"
 #include "../RayTracer.hpp"
+#include "../bvh/BVHStatistics.hpp"
 
 namespace RayTracing {
     class SequentialRayTracer : public RayTracer {
     protected:
+        /// Closest intersection of a ray with the scene and the surface properties at the hit
+        struct SurfaceHit {
+            /// intersection with hit point in world space
+            HitInfo hit{.hit = false, .distance = INFINITY};
+            /// surface normal in world space
+            Vec3 normal;
+            RGBf color;
+            float specularIntensity = 0.0f;
+        };
+
         void resolveRays(Image *image, std::vector<Ray> &rays, ColorBlendMode mode = AVERAGE) const;
 
+        /**
+         * Get the color a traced ray contributes to its pixel
+         * @param ray ray after all of its bounces
+         * @return throughput of the path times the color of the light source it ended in
+         */
+        static RGBf pathColor(const Ray &ray);
+
+        /**
+         * Find the closest intersection of a ray with all meshes, spheres and light sources of the scene
+         * @param scene prepared scene to intersect
+         * @param ray ray in world space
+         * @param statistics if not null, the tests done in every hierarchy are counted in it
+         * @return closest hit, hit.hit is false if nothing was hit
+         */
+        static SurfaceHit findClosestHit(const Scene &scene, const Ray &ray, BVHStatistics *statistics = nullptr);
+
+        /**
+         * Find the closest intersections of all rays of a packet with the scene, meshes are traversed by the whole
+         * packet at once
+         * @param scene prepared scene to intersect
+         * @param packet rays in world space, their distances are shortened to their closest hits
+         * @param hits closest hit of every ray of the packet
+         */
+        static void findClosestHits(const Scene &scene, RayPacket &packet, SurfaceHit *hits);
+
+        /**
+         * Intersect a ray with a single instance of the top level hierarchy and keep the hit if it is closer
+         * @param scene prepared scene the instance belongs to
+         * @param instance mesh, sphere or light source to intersect
+         * @param ray ray in world space
+         * @param closest closest hit so far
+         * @param statistics if not null, the tests done in the hierarchy of a mesh are counted in it
+         */
+        static void intersectInstance(const Scene &scene, const TopLevelInstance &instance, const Ray &ray,
+                                      SurfaceHit &closest, BVHStatistics *statistics = nullptr);
+
+        /**
+         * Keep the intersection of a ray with a mesh if it is closer than the closest hit so far
+         * @param object intersected mesh object
+         * @param ray ray in world space
+         * @param intersection intersection in local object space
+         * @param closest closest hit so far
+         */
+        static void keepMeshHit(const MeshedRayTraceableObject &object, const Ray &ray, const HitInfo &intersection,
+                                SurfaceHit &closest);
+
+        /**
+         * Multiply the color of a hit surface into the throughput of the ray and reflect the ray at the hit
+         * @param ray ray that hit the surface, updated in place
+         * @param hit closest hit of the ray
+         * @return true if the ray continues bouncing
+         */
+        static bool bounceAt(Ray &ray, const SurfaceHit &hit);
+
+        /**
+         * Trace a ray through all bounces and accumulate the colors of the hit surfaces in its throughput
+         * @param scene prepared scene to trace
+         * @param ray ray to trace, updated in place
+         * @param statistics if not null, the tests done in every hierarchy are counted in it
+         * @param firstBounce number of bounces the ray already did
+         */
+        void traceRay(const Scene &scene, Ray &ray, BVHStatistics *statistics = nullptr,
+                      unsigned firstBounce = 0) const;
+
+        /**
+         * Trace the first bounce of camera rays as one packet, the following bounces are traced ray by ray
+         * @param scene prepared scene to trace
+         * @param rays all camera rays, the rays of the packet are updated in place
+         * @param rayIndices indices of the rays of the packet
+         * @param count number of rays in the packet, at most RayPacket::MAX_SIZE
+         */
+        void tracePacket(const Scene &scene, std::vector<Ray> &rays, const unsigned *rayIndices,
+                         unsigned count) const;
+
+        /**
+         * Group the camera rays into packets of neighbouring pixels. Packets are split if the pixels of a tile have
+         * more samples than fit into one packet.
+         * @param packetSize width and height of the pixel tile of a packet
+         * @param rayIndices filled with the indices of all camera rays, the rays of a packet follow each other
+         * @return index of the first ray of every packet in rayIndices, followed by the total number of rays
+         */
+        std::vector<unsigned> groupRayPackets(unsigned packetSize, std::vector<unsigned> &rayIndices) const;
+
     public:
         SequentialRayTracer(const Vec2u &windowSize, unsigned bounces, unsigned samplesPerPixel);
 
@@ -29,6 +125,49 @@ namespace RayTracing {
          */
         Image *rayTest(Camera *camera) override;
 
+        /**
+         * Check if anything blocks a ray before maxDistance, for shadow and visibility queries. Meshes and spheres
+         * block rays, light sources do not. The traversal stops at the first hit found instead of searching the
+         * closest one.
+         * @param scene prepared scene to test
+         * @param ray ray in world space
+         * @param maxDistance only hits closer than this distance along the ray count, e.g. the distance to a light
+         * @param statistics if not null, the tests done in every hierarchy are counted in it
+         * @return true if the ray is blocked
+         */
+        static bool occluded(const Scene &scene, const Ray &ray, float maxDistance,
+                             BVHStatistics *statistics = nullptr);
+
+        /**
+         * Check a batch of rays for occlusion in parallel
+         * @param scene prepared scene to test
+         * @param rays rays in world space
+         * @param maxDistances maximum distance of every ray
+         * @param result set to 1 for every blocked ray and 0 otherwise, resized to the number of rays
+         */
+        static void occluded(const Scene &scene, const std::vector<Ray> &rays, const std::vector<float> &maxDistances,
+                             std::vector<uint8_t> &result);
+
+        /**
+         * Trace a sample of the camera rays of a render through all bounces and count the node and triangle tests of
+         * every hierarchy. The rendered image is not changed.
+         * @param scene prepared scene
+         * @param statistics statistics of the scene, the traversal counters are added to it
+         * @param rayStride only every rayStride-th camera ray is traced
+         */
+        void sampleTraversal(const Scene &scene, BVHStatistics &statistics, unsigned rayStride);
+
+        /**
+         * Trace one sample of every pixel that is not converged yet through all bounces and add its color to an
+         * accumulation buffer, one pass of progressive rendering. Camera rays are generated on the fly and traced
+         * alone.
+         * @param scene prepared scene
+         * @param accumulation buffer of the size of the window
+         * @param sample index of the pass, selects the sampling offset inside of the pixels and seeds the random
+         * numbers of the rays
+         */
+        virtual void tracePass(const Scene &scene, AccumulationBuffer &accumulation, unsigned sample);
+
         /// Get the identifier of the raytracer
         std::string identifier() override { return "SequentialRayTracer"; }
     };
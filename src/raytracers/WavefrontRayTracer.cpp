@@ -0,0 +1,112 @@
+#include "WavefrontRayTracer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include "../timing.hpp"
+
+namespace RayTracing {
+    WavefrontRayTracer::WavefrontRayTracer(const Vec2u &windowSize, unsigned bounces, unsigned samplesPerPixel)
+        : SequentialRayTracer(windowSize, bounces, samplesPerPixel) {
+    }
+
+    Image *WavefrontRayTracer::raytrace(Scene scene) {
+        TIMING_START(prepping)
+        auto *image = new Image(getWindowSize());
+        scene.prepareRender();
+        TIMING_END(prepping)
+        TIMING_LOG(prepping, RaytracingTimer::Component::SCENE_LOADING, "prepping scene for raytracing")
+        TIMING_START(rays)
+        auto rays = calculateStartingRays(scene.camera);
+        TIMING_END(rays)
+        TIMING_LOG(rays, RaytracingTimer::Component::ENCODING, "calculating starting rays")
+        std::cout << "[" << identifier() << "] Starting raytrace with "
+                << getRayCount() << " rays, "
+                << scene.objects.size() << " mesh objects (" << scene.getTriangleCount() << " triangles), "
+                << scene.spheres.size() << " spheres and "
+                << scene.lights.size() << " light sources"
+                << std::endl;
+        std::cout << "[" << identifier() << "]" << " Maximum nested bounding box depth: " << scene.getNestingDepth() <<
+                std::endl;
+
+        TIMING_START(tracing)
+        const BoundingBox bounds = scene.topLevelBVH.nodes.empty()
+                                       ? BoundingBox(Vec3::zero(), Vec3::zero())
+                                       : scene.topLevelBVH.nodes[0].bounds;
+        std::vector<unsigned> queue(rays.size());
+        std::iota(queue.begin(), queue.end(), 0);
+        std::vector<SurfaceHit> hits;
+        std::vector<uint8_t> bouncing;
+        for (unsigned bounce = 0; bounce < getBounces() && !queue.empty(); bounce++) {
+            if (bounce > 0) {
+                // camera rays are already coherent in pixel order
+                binRays(rays, queue, bounds);
+            }
+
+            hits.resize(queue.size());
+#pragma omp parallel for schedule(dynamic, 256)
+            for (size_t i = 0; i < queue.size(); i++) {
+                hits[i] = findClosestHit(scene, rays[queue[i]]);
+            }
+
+            bouncing.resize(queue.size());
+#pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < queue.size(); i++) {
+                bouncing[i] = bounceAt(rays[queue[i]], hits[i]);
+            }
+
+            // drop terminated rays, the order of the remaining ones is kept
+            size_t active = 0;
+            for (size_t i = 0; i < queue.size(); i++) {
+                if (bouncing[i]) {
+                    queue[active++] = queue[i];
+                }
+            }
+            queue.resize(active);
+            std::cout << "\r" << "bounce " << bounce + 1 << "/" << getBounces() << ": " << active << "/" << rays.size()
+                    << " rays still bouncing" << std::flush;
+        }
+        std::cout << '\r';
+        TIMING_END(tracing)
+        TIMING_LOG(tracing, RaytracingTimer::Component::RAYTRACING, "tracing rays")
+
+        TIMING_START(resolve)
+        resolveRays(image, rays);
+        TIMING_END(resolve)
+        TIMING_LOG(resolve, RaytracingTimer::Component::DECODING, "resolving rays into image")
+
+        return image;
+    }
+
+    void WavefrontRayTracer::binRays(const std::vector<Ray> &rays, std::vector<unsigned> &queue,
+                                     const BoundingBox &bounds) {
+        constexpr unsigned cells = ORIGIN_GRID_SIZE * ORIGIN_GRID_SIZE * ORIGIN_GRID_SIZE;
+        constexpr unsigned bins = 8 * cells;
+        const Vec3 size = bounds.size();
+
+        // counting sort by bin, stable so rays of the same bin stay in pixel order
+        std::vector<unsigned> binOfRay(queue.size());
+        std::vector<unsigned> binStart(bins + 1, 0);
+        for (size_t i = 0; i < queue.size(); i++) {
+            const Ray &ray = rays[queue[i]];
+            unsigned octant = 0;
+            unsigned cell = 0;
+            for (auto axis: {Vec3::X_AXIS, Vec3::Y_AXIS, Vec3::Z_AXIS}) {
+                octant = octant << 1 | (ray.direction[axis] < 0 ? 1 : 0);
+                float relative = size[axis] > 0 ? (ray.origin[axis] - bounds.minPos[axis]) / size[axis] : 0;
+                cell = cell * ORIGIN_GRID_SIZE +
+                       (unsigned) std::clamp(relative * ORIGIN_GRID_SIZE, 0.0f, ORIGIN_GRID_SIZE - 1.0f);
+            }
+            binOfRay[i] = octant * cells + cell;
+            binStart[binOfRay[i] + 1]++;
+        }
+        std::partial_sum(binStart.begin(), binStart.end(), binStart.begin());
+
+        std::vector<unsigned> binned(queue.size());
+        for (size_t i = 0; i < queue.size(); i++) {
+            binned[binStart[binOfRay[i]]++] = queue[i];
+        }
+        queue.swap(binned);
+    }
+}
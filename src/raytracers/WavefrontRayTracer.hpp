@@ -0,0 +1,40 @@
+#pragma once
+#include "SequentialRayTracer.hpp"
+
+namespace RayTracing {
+    /**
+     * Raytracer implementation processing the image bounce by bounce on the CPU.
+     * All active rays are intersected with the scene in one pass and shaded in a second one, terminated rays are
+     * dropped from the queue. Between bounces the queue is binned by direction octant and origin cell, so rays
+     * traversing the same parts of the hierarchies are traced after each other.
+     */
+    class WavefrontRayTracer : public SequentialRayTracer {
+    private:
+        /// number of origin cells per axis the ray queue is binned by
+        static constexpr unsigned ORIGIN_GRID_SIZE = 16;
+
+        /**
+         * Reorder the queue by the direction octant and the cell of the origin of its rays, rays in the same bin keep
+         * their order
+         * @param rays all rays of the image
+         * @param queue indices of the active rays, reordered in place
+         * @param bounds bounds of the scene, origins outside of it are clamped into the border cells
+         */
+        static void binRays(const std::vector<Ray> &rays, std::vector<unsigned> &queue, const BoundingBox &bounds);
+
+    public:
+        WavefrontRayTracer(const Vec2u &windowSize, unsigned bounces, unsigned samplesPerPixel);
+
+        /**
+         * Raytrace a scene and generate image
+         * @param scene scene to raytrace
+         * @return raytraced image
+         */
+        Image *raytrace(Scene scene) override;
+
+        /// Get the identifier of the raytracer
+        std::string identifier() override {
+            return "WavefrontRayTracer";
+        }
+    };
+}